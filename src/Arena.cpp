@@ -0,0 +1,111 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "Arena.h"
+
+#include <algorithm>
+
+namespace {
+    thread_local WW::Arena* t_arena = 0;
+
+    /** Every block starts with the arena it came from, or zero, padded so
+     * that what follows is aligned as the global allocator would align it.
+     */
+    struct Header
+    {
+        WW::Arena* arena;
+    };
+
+    const size_t HEADER_SIZE = alignof(std::max_align_t);
+}
+
+WW::Arena::Arena()
+: m_chunks()
+, m_next(0)
+, m_end(0)
+{
+    std::fill(m_free, m_free + MAX_BLOCK / GRAIN, static_cast<void*>(0));
+}
+
+WW::Arena::~Arena()
+{
+    for (std::vector<char*>::const_iterator it = m_chunks.begin(); it != m_chunks.end(); ++it) {
+        ::operator delete(*it);
+    }
+}
+
+WW::Arena*
+WW::Arena::current()
+{
+    return t_arena;
+}
+
+void
+WW::Arena::setCurrent(Arena* arena)
+{
+    t_arena = arena;
+}
+
+void*
+WW::Arena::obtain(size_t size)
+{
+    size += HEADER_SIZE;
+    Arena* arena = t_arena;
+    Header* header = 0;
+    if (arena != 0 && size <= MAX_BLOCK) {
+        header = static_cast<Header*>(arena->allocate(size));
+    }
+    else {
+        arena = 0;
+        header = static_cast<Header*>(::operator new(size));
+    }
+    header->arena = arena;
+    return reinterpret_cast<char*>(header) + HEADER_SIZE;
+}
+
+void
+WW::Arena::release(void* pointer, size_t size)
+{
+    if (pointer == 0) {
+        return;
+    }
+    Header* header = reinterpret_cast<Header*>(static_cast<char*>(pointer) - HEADER_SIZE);
+    if (header->arena == 0) {
+        ::operator delete(header);
+    }
+    else if (header->arena == t_arena) {
+        t_arena->deallocate(header, size + HEADER_SIZE);
+    }
+    // otherwise it belongs to another thread's arena, and goes with it
+}
+
+void*
+WW::Arena::allocate(size_t size)
+{
+    size_t grains = (size + GRAIN - 1) / GRAIN;
+    void*& free = m_free[grains - 1];
+    if (free != 0) {
+        void* result = free;
+        free = *static_cast<void**>(result);
+        return result;
+    }
+    size = grains * GRAIN;
+    if (static_cast<size_t>(m_end - m_next) < size) {
+        m_chunks.push_back(static_cast<char*>(::operator new(CHUNK_SIZE)));
+        m_next = m_chunks.back();
+        m_end = m_next + CHUNK_SIZE;
+    }
+    void* result = m_next;
+    m_next += size;
+    return result;
+}
+
+void
+WW::Arena::deallocate(void* pointer, size_t size)
+{
+    void*& free = m_free[(size + GRAIN - 1) / GRAIN - 1];
+    *static_cast<void**>(pointer) = free;
+    free = pointer;
+}
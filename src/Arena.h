@@ -0,0 +1,102 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_ARENA_HEADER
+#define INCLUDE_WW_ARENA_HEADER
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace WW
+{
+    /** Memory for the temporaries of one thread's share of a calculation.
+     *
+     * Small blocks are carved from large chunks, and a block given back is
+     * kept on a free list for the next of the same size, so once an arena has
+     * grown to its working size it rarely needs the global allocator.  The
+     * chunks are only released when the arena is destroyed.
+     *
+     * An ArenaAllocator takes its memory from the arena made current on the
+     * calling thread, or from the global allocator if there is none; each
+     * block records where it came from.  A block given back on a thread whose
+     * current arena is not the one it came from is left to be released with
+     * that arena, so arenas are never shared between threads, but everything
+     * allocated from an arena must be destroyed before the arena is.
+     */
+    class Arena
+    {
+    public:
+        ~Arena();
+        Arena();
+
+    private: // forbid copy and assignment
+        Arena(const Arena& copy);
+        Arena& operator=(const Arena& copy);
+
+    public:
+        /** The arena used on the calling thread, or zero */
+        static Arena* current();
+        static void setCurrent(Arena* arena);
+
+        /** A block of `size` bytes, from the current arena if there is one */
+        static void* obtain(size_t size);
+        /** Give back a block from obtain() */
+        static void release(void* pointer, size_t size);
+
+        /** Bytes of chunks taken from the global allocator */
+        size_t reserved() const { return m_chunks.size() * CHUNK_SIZE; }
+
+    private:
+        void* allocate(size_t size);
+        void deallocate(void* pointer, size_t size);
+
+        static const size_t GRAIN = 16; // block sizes are multiples of this
+        static const size_t MAX_BLOCK = 1024; // larger blocks come from the global allocator
+        static const size_t CHUNK_SIZE = 64 * 1024;
+
+    private:
+        std::vector<char*> m_chunks;
+        char* m_next; // unused part of the last chunk
+        char* m_end;
+        void* m_free[MAX_BLOCK / GRAIN]; // by size, blocks given back, each holding the next
+    };
+
+    /** Makes an arena current on the calling thread for its lifetime */
+    class ScopedArena
+    {
+    public:
+        explicit ScopedArena(Arena* arena) : m_previous(Arena::current()) { Arena::setCurrent(arena); }
+        ~ScopedArena() { Arena::setCurrent(m_previous); }
+
+    private: // forbid copy and assignment
+        ScopedArena(const ScopedArena& copy);
+        ScopedArena& operator=(const ScopedArena& copy);
+
+    private:
+        Arena* m_previous;
+    };
+
+    /** Allocates from the calling thread's current arena; see Arena */
+    template <class _T>
+        class ArenaAllocator
+        {
+        public:
+            typedef _T value_type;
+
+        public:
+            ArenaAllocator() {}
+            template <class _U>
+                ArenaAllocator(const ArenaAllocator<_U>&) {}
+
+            _T* allocate(size_t count) { return static_cast<_T*>(Arena::obtain(count * sizeof(_T))); }
+            void deallocate(_T* pointer, size_t count) { Arena::release(pointer, count * sizeof(_T)); }
+
+            bool operator==(const ArenaAllocator&) const { return true; }
+            bool operator!=(const ArenaAllocator&) const { return false; }
+        };
+}
+
+#endif // INCLUDE_WW_ARENA_HEADER
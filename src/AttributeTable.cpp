@@ -0,0 +1,78 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "AttributeTable.h"
+
+WW::AttributeTable::AttributeTable()
+: m_keyIds()
+, m_keys()
+, m_valueIds()
+, m_values(1)
+{
+}
+
+WW::AttributeTable::id_t
+WW::AttributeTable::lookup(map_t& map, std::vector<std::string>& names, const std::string& name)
+{
+    map_t::const_iterator it = map.find(name);
+    if (it != map.end()) {
+        return it->second;
+    }
+    id_t id = static_cast<id_t>(names.size());
+    names.push_back(name);
+    map.insert(map_t::value_type(name, id));
+    return id;
+}
+
+WW::AttributeId
+WW::AttributeTable::intern(const attribute_t& attribute)
+{
+    const std::string& value = attribute.value();
+    std::string::size_type pos = value.find('=');
+    if (pos == std::string::npos) {
+        return AttributeId(lookup(m_keyIds, m_keys, value), AttributeId::NO_VALUE, attribute.isForbidden());
+    }
+    id_t key = lookup(m_keyIds, m_keys, value.substr(0, pos));
+    return AttributeId(key, lookup(m_valueIds, m_values, value.substr(pos + 1)), attribute.isForbidden());
+}
+
+WW::AttributeTable::ids_t
+WW::AttributeTable::intern(const attributes_t& attributes)
+{
+    ids_t result;
+    result.reserve(attributes.size());
+    for (attributes_t::const_iterator it = attributes.begin(); it != attributes.end(); ++it) {
+        result.insert(intern(*it));
+    }
+    return result;
+}
+
+WW::AttributeTable::id_operation_t
+WW::AttributeTable::intern(const operation_t& operation)
+{
+    id_operation_t result;
+    result.dependencies(intern(operation.dependencies()));
+    result.changes(intern(operation.changes()));
+    return result;
+}
+
+WW::AttributeTable::attribute_t
+WW::AttributeTable::name(const AttributeId& attribute) const
+{
+    if (attribute.isCompound()) {
+        return attribute_t(m_keys[attribute.key()] + "=" + m_values[attribute.compoundValue()], attribute.isForbidden());
+    }
+    return attribute_t(m_keys[attribute.key()], attribute.isForbidden());
+}
+
+WW::AttributeTable::attributes_t
+WW::AttributeTable::names(const ids_t& attributes) const
+{
+    attributes_t result;
+    for (ids_t::const_iterator it = attributes.begin(); it != attributes.end(); ++it) {
+        result.insert(name(*it));
+    }
+    return result;
+}
@@ -0,0 +1,63 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_ATTRIBUTETABLE_HEADER
+#define INCLUDE_WW_ATTRIBUTETABLE_HEADER
+
+#include "attributeid.h"
+#include "operation.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace WW
+{
+    /** Interns attribute strings as small integer ids.
+     *
+     * Compound keys and values are interned separately, so that every
+     * `key=value` with the same key shares a key id.  Key ids are dense and
+     * start from zero.  Value ids start from one; AttributeId::NO_VALUE marks
+     * a simple attribute.
+     */
+    class AttributeTable
+    {
+    public:
+        typedef AttributeId::id_t id_t;
+        typedef Attribute<std::string> attribute_t;
+        typedef Attributes<std::string> attributes_t;
+        typedef Operation<std::string> operation_t;
+        typedef Attributes<AttributeId> ids_t;
+        typedef Operation<AttributeId> id_operation_t;
+
+    public:
+        ~AttributeTable() {}
+        AttributeTable();
+
+    public:
+        AttributeId intern(const attribute_t& attribute);
+        ids_t intern(const attributes_t& attributes);
+        id_operation_t intern(const operation_t& operation);
+
+        attribute_t name(const AttributeId& attribute) const;
+        attributes_t names(const ids_t& attributes) const;
+        const std::string& key(id_t key) const { return m_keys[key]; }
+
+        size_t keyCount() const { return m_keys.size(); }
+        size_t valueCount() const { return m_values.size() - 1; }
+
+    private:
+        typedef std::unordered_map<std::string, id_t> map_t;
+        static id_t lookup(map_t& map, std::vector<std::string>& names, const std::string& name);
+
+    private:
+        map_t m_keyIds;
+        std::vector<std::string> m_keys;
+        map_t m_valueIds;
+        std::vector<std::string> m_values; // index 0 is reserved for NO_VALUE
+    };
+}
+
+#endif // INCLUDE_WW_ATTRIBUTETABLE_HEADER
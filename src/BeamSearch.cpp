@@ -0,0 +1,278 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "BeamSearch.h"
+
+#include "Insertion.h"
+#include "Solver.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+typedef WW::state_t state_t;
+
+namespace {
+
+    /** A partial order of the pending steps, kept by the beam search */
+    struct BeamEntry
+    {
+        BeamEntry() : order(), cost(0), greedy(false), walk(), walked(false) {}
+        WW::StepList order;
+        int cost; // of the plan solveForSequence() makes for the order, looking ahead
+        bool greedy; // the order inserting each step at its best point would reach
+        WW::SequenceWalk walk; // of that plan
+        bool walked; // whether `walk` is whole; the greedy order may not run looking ahead
+    };
+
+    /** The outcome of inserting the next step into a beam entry before
+     * `position`, or at the end if that is the size of its order
+     */
+    struct BeamCandidate
+    {
+        BeamCandidate() : entry(0), position(0), cost(0), valid(false), walk(), insertionCost(0), insertionValid(false) {}
+        size_t entry;
+        size_t position;
+        int cost; // as solveForSequence() reports, looking ahead
+        bool valid;
+        WW::SequenceWalk walk; // of the plan for the order the candidate makes
+        int insertionCost; // as bestInsertionPoint() costs it, solving for each step alone
+        bool insertionValid;
+    };
+
+    /** Candidates costed looking ahead for each order the beam keeps; the
+     * rest are ranked out by the cost of solving for each step alone, which
+     * is much cheaper to work out
+     */
+    const size_t BEAM_SHORTLIST = 2;
+
+    /** Cost the candidate inserting `step` into `order`, as solveForSequence()
+     * reports for the order it makes when it looks ahead, and walk that
+     * plan.  `walk` is the walk of the plan for `order`.  Only the items
+     * whose look-ahead reaches the step are solved afresh, along with
+     * whatever follows it until the state rejoins `walk`; after the step,
+     * each item looks ahead along the same items as before.
+     */
+    void
+        evaluateCandidate(const WW::TestStep& step, const WW::StepList& order, const WW::SequenceWalk& walk, WW::SolveContext& context, BeamCandidate& out_candidate)
+        {
+            const size_t position = out_candidate.position;
+            const size_t first = (position + 1 < WW::LOOK_AHEAD) ? 0 : position + 1 - WW::LOOK_AHEAD;
+            WW::StepList::const_iterator from = order.begin();
+            std::advance(from, first);
+            WW::StepList sequence(from, order.end());
+            WW::StepList::iterator at = sequence.begin();
+            std::advance(at, position - first);
+            sequence.insert(at, step);
+
+            WW::ScratchList scratch(context);
+            WW::StepList& solution = scratch.list();
+            WW::SequenceWalk& out_walk = out_candidate.walk;
+            out_walk.states.assign(walk.states.begin(), walk.states.begin() + first);
+            out_walk.costs.assign(walk.costs.begin(), walk.costs.begin() + first);
+            state_t state = walk.states[first];
+            int cost = walk.costs[first];
+            WW::StepList::const_iterator scanEnd = sequence.begin();
+            for (size_t i = 1; i < WW::LOOK_AHEAD && scanEnd != sequence.end(); ++i) {
+                ++scanEnd;
+            }
+            size_t index = first; // in the order with the step inserted
+            WW::StepList::const_iterator it = sequence.begin();
+            for (; it != sequence.end(); ++it, ++index) {
+                if (index > position && state == walk.states[index - 1]) {
+                    // the rest is as it was, for what this has cost so far
+                    const int offset = cost - walk.costs[index - 1];
+                    for (size_t rest = index - 1; rest < walk.states.size(); ++rest) {
+                        out_walk.states.push_back(walk.states[rest]);
+                        out_walk.costs.push_back(walk.costs[rest] + offset);
+                    }
+                    cost = out_walk.costs.back();
+                    break;
+                }
+                out_walk.states.push_back(state);
+                out_walk.costs.push_back(cost);
+                if (scanEnd != sequence.end()) {
+                    ++scanEnd;
+                }
+                int item_cost = WW::solve(state, context.operation(*it).dependencies(), context, solution, it, scanEnd);
+                if (solution.empty() && item_cost > 0) {
+                    return; // empty solution means failure
+                }
+                cost += item_cost + it->cost();
+                WW::applyState(state, solution, context);
+                context.operation(*it).modify(state);
+            }
+            if (it == sequence.end()) {
+                out_walk.states.push_back(state);
+                out_walk.costs.push_back(cost);
+            }
+            out_candidate.cost = cost;
+            out_candidate.valid = true;
+        }
+}
+
+bool
+WW::orderByBeam(const state_t& state, const WW::StepList& pending, WW::SolverThreads& threads, size_t width, const WW::Deadline& deadline, WW::StepList& out_best, WW::StepList& out_greedy, WW::Progress& progress)
+{
+    std::vector<BeamEntry> beam(1);
+    beam[0].greedy = true;
+    beam[0].walk.states.push_back(state);
+    beam[0].walk.costs.push_back(0);
+    beam[0].walked = true;
+    WW::StepList::const_iterator step = pending.begin();
+    for (; step != pending.end() && !deadline.passed(); ++step) {
+        progress.place();
+        std::vector<WW::SequenceWalk> walks(beam.size());
+        threads.pool().run(beam.size(), [&](size_t entry, unsigned int worker) {
+            WW::ScopedSearch search(threads.context(worker), 0);
+            WW::walkSequence(state, beam[entry].order, threads.context(worker), walks[entry]);
+        });
+
+        std::vector<std::vector<WW::StepList::iterator> > positions(beam.size());
+        std::vector<BeamCandidate> candidates;
+        for (size_t entry = 0; entry < beam.size(); ++entry) {
+            WW::StepList& order = beam[entry].order;
+            for (WW::StepList::iterator it = order.begin(); ; ++it) {
+                BeamCandidate candidate;
+                candidate.entry = entry;
+                candidate.position = positions[entry].size();
+                candidates.push_back(candidate);
+                positions[entry].push_back(it);
+                if (it == order.end()) {
+                    break;
+                }
+            }
+        }
+        threads.pool().run(candidates.size(), [&](size_t index, unsigned int worker) {
+            BeamCandidate& candidate = candidates[index];
+            const WW::SequenceWalk& walk = walks[candidate.entry];
+            const WW::StepList::iterator it = positions[candidate.entry][candidate.position];
+            const WW::StepList::const_iterator end = beam[candidate.entry].order.end();
+            WW::SolveContext& context = threads.context(worker);
+            WW::ScopedSearch search(context, 0);
+            if (it != end) {
+                WW::InsertionCost cost;
+                WW::evaluateInsertionPoint(*step, it, end, candidate.position, walk, context, cost);
+                candidate.insertionCost = cost.cost;
+                candidate.insertionValid = cost.valid;
+                return;
+            }
+            WW::ScratchList scratch(context);
+            WW::StepList& solution = scratch.list();
+            int cost = WW::solve(walk.states.back(), context.operation(*step).dependencies(), context, solution);
+            if (cost == 0 || !solution.empty()) {
+                candidate.insertionCost = walk.costs.back() + cost + step->cost();
+                candidate.insertionValid = true;
+            }
+        });
+
+        // The point bestInsertionPoint() would choose in the greedy order
+        size_t greedyEntry = 0;
+        while (!beam[greedyEntry].greedy) {
+            ++greedyEntry;
+        }
+        BeamCandidate* greedy = 0;
+        for (std::vector<BeamCandidate>::iterator it = candidates.begin(); it != candidates.end(); ++it) {
+            if (it->entry != greedyEntry) {
+                continue;
+            }
+            if (it->position + 1 == positions[greedyEntry].size() && greedy == 0) {
+                greedy = &*it; // nowhere else is valid
+            }
+            else if (it->insertionValid && (greedy == 0 || it->insertionCost < greedy->insertionCost)) {
+                greedy = &*it;
+            }
+        }
+
+        std::vector<BeamCandidate*> shortlist;
+        for (std::vector<BeamCandidate>::iterator it = candidates.begin(); it != candidates.end(); ++it) {
+            if (it->insertionValid) {
+                shortlist.push_back(&*it);
+            }
+        }
+        std::stable_sort(shortlist.begin(), shortlist.end(), [](const BeamCandidate* lhs, const BeamCandidate* rhs) {
+            return lhs->insertionCost < rhs->insertionCost;
+        });
+        if (shortlist.size() > width * BEAM_SHORTLIST) {
+            shortlist.resize(width * BEAM_SHORTLIST);
+        }
+        if (std::find(shortlist.begin(), shortlist.end(), greedy) == shortlist.end()) {
+            shortlist.push_back(greedy);
+        }
+
+        threads.pool().run(shortlist.size(), [&](size_t index, unsigned int worker) {
+            BeamCandidate& candidate = *shortlist[index];
+            const BeamEntry& entry = beam[candidate.entry];
+            if (entry.walked) {
+                WW::ScopedSearch search(threads.context(worker), 0);
+                evaluateCandidate(*step, entry.order, entry.walk, threads.context(worker), candidate);
+            }
+        });
+
+        std::vector<const BeamCandidate*> ranked;
+        for (std::vector<BeamCandidate*>::const_iterator it = shortlist.begin(); it != shortlist.end(); ++it) {
+            if ((*it)->valid || *it == greedy) {
+                ranked.push_back(*it);
+            }
+        }
+        std::stable_sort(ranked.begin(), ranked.end(), [](const BeamCandidate* lhs, const BeamCandidate* rhs) {
+            return (lhs->valid ? lhs->cost : WW::UNBOUNDED) < (rhs->valid ? rhs->cost : WW::UNBOUNDED);
+        });
+
+        std::vector<BeamEntry> next;
+        std::map<std::vector<const WW::TestStep*>, size_t> kept; // index in `next` of each order
+        bool greedyKept = false;
+        for (std::vector<const BeamCandidate*>::const_iterator it = ranked.begin(); it != ranked.end() && !(next.size() == width && greedyKept); ++it) {
+            const bool isGreedy = (*it == greedy);
+            if (next.size() == width && !isGreedy) {
+                continue;
+            }
+            BeamEntry entry;
+            entry.order = beam[(*it)->entry].order;
+            WW::StepList::iterator at = entry.order.begin();
+            std::advance(at, (*it)->position);
+            entry.order.insert(at, *step);
+            entry.cost = (*it)->cost;
+            entry.greedy = isGreedy;
+            entry.walk = (*it)->walk;
+            entry.walked = (*it)->valid;
+            std::vector<const WW::TestStep*> key;
+            for (WW::StepList::const_iterator member = entry.order.begin(); member != entry.order.end(); ++member) {
+                key.push_back(&*member);
+            }
+            std::map<std::vector<const WW::TestStep*>, size_t>::const_iterator found = kept.find(key);
+            if (found != kept.end()) {
+                next[found->second].greedy = next[found->second].greedy || isGreedy;
+            }
+            else if (next.size() < width) {
+                kept[key] = next.size();
+                next.push_back(entry);
+            }
+            else {
+                next.back() = entry; // the greedy order displaces the dearest
+            }
+            greedyKept = greedyKept || isGreedy;
+        }
+        beam.swap(next);
+    }
+
+    out_best.clear();
+    out_greedy.clear();
+    for (std::vector<BeamEntry>::const_iterator it = beam.begin(); it != beam.end(); ++it) {
+        if (it == beam.begin()) {
+            WW::append(out_best, it->order);
+        }
+        if (it->greedy) {
+            WW::append(out_greedy, it->order);
+        }
+    }
+    const bool finished = (step == pending.end());
+    for (; step != pending.end(); ++step) {
+        progress.place();
+        out_best.push_back(*step);
+        out_greedy.push_back(*step);
+    }
+    return finished;
+}
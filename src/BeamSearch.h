@@ -0,0 +1,36 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_BEAMSEARCH_HEADER
+#define INCLUDE_WW_BEAMSEARCH_HEADER
+
+#include "CompiledSteps.h"
+#include "Ordering.h"
+#include "StepList.h"
+
+#include <cstddef>
+
+namespace WW
+{
+    class Progress;
+    class SolverThreads;
+
+    /** Order the `pending` steps by a beam search: each in turn is tried at
+     * every point of each of the `width` cheapest orders so far, and the
+     * `width` cheapest of those become the next.  Every candidate is costed
+     * as by bestInsertionPoint(), and the `BEAM_SHORTLIST` cheapest for
+     * each order kept are costed again as solveForSequence() costs the plan
+     * for the order when it looks ahead, which is the plan taken; those are
+     * what the beam ranks.
+     *
+     * The order bestInsertionPoint() alone would reach is always kept, so it
+     * is one of the two returned; `out_best` is the cheapest of the beam.
+     * Once `deadline` has passed the beam stops, and the steps it has not
+     * reached are put at the end of both in turn; false if any were.
+     */
+    bool orderByBeam(const state_t& state, const StepList& pending, SolverThreads& threads, size_t width, const Deadline& deadline, StepList& out_best, StepList& out_greedy, Progress& progress);
+}
+
+#endif // INCLUDE_WW_BEAMSEARCH_HEADER
@@ -0,0 +1,188 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "CompiledSteps.h"
+
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+typedef WW::state_t state_t;
+typedef WW::operation_t operation_t;
+
+namespace {
+
+    /** Whether every attribute of `subset` is in `superset` too */
+    bool
+        isSubset(const state_t& subset, const state_t& superset)
+        {
+            for (state_t::const_iterator it = subset.begin(); it != subset.end(); ++it) {
+                state_t::const_iterator match = superset.find(it->key());
+                if (match == superset.end() || *match != *it) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    /** Find the dominance of each step.  A required step is never dominated.
+     *
+     * The recursive engine is not guaranteed to find the cheapest solution,
+     * nor one at least as cheap for dependencies which are a superset of
+     * another's, so only an exact duplicate can be left out of its choices
+     * without changing them.  Even that is only so when it compares
+     * candidates by their own outcome, without a chain to guide it.
+     */
+    void
+        findDominated(const std::vector<const WW::TestStep*>& steps, const std::vector<operation_t>& operations, std::vector<WW::dominance_t>& out_result)
+        {
+            out_result.assign(steps.size(), WW::UNDOMINATED);
+            std::unordered_map<state_t, std::vector<size_t>, WW::StateHash> byChanges;
+            for (size_t i = 0; i < operations.size(); ++i) {
+                byChanges[operations[i].changes()].push_back(i);
+            }
+            for (std::unordered_map<state_t, std::vector<size_t>, WW::StateHash>::const_iterator group = byChanges.begin(); group != byChanges.end(); ++group) {
+                const std::vector<size_t>& members = group->second;
+                for (std::vector<size_t>::const_iterator it = members.begin(); it != members.end(); ++it) {
+                    if (steps[*it]->required()) {
+                        continue;
+                    }
+                    const int cost = steps[*it]->cost();
+                    const state_t& dependencies = operations[*it].dependencies();
+                    for (std::vector<size_t>::const_iterator other = members.begin(); other != members.end() && out_result[*it] != WW::DUPLICATED; ++other) {
+                        const int otherCost = steps[*other]->cost();
+                        if ((otherCost < cost || (otherCost == cost && *other < *it)) && isSubset(operations[*other].dependencies(), dependencies)) {
+                            out_result[*it] = (operations[*other].dependencies() == dependencies) ? WW::DUPLICATED : WW::DOMINATED;
+                        }
+                    }
+                }
+            }
+        }
+
+    /** The operation equivalent to running each of `members` in turn.
+     *
+     * Its dependencies are those of the members which no earlier member
+     * decides, and its changes are the last made to each key.  Returns
+     * false if there is no such operation: a member needs what an earlier
+     * one has undone, or two need a key to start out differently.
+     */
+    bool
+        combineOperations(const std::vector<const operation_t*>& members, operation_t& out_result)
+        {
+            state_t dependencies;
+            state_t changes; // forbidden where a key is removed
+            for (std::vector<const operation_t*>::const_iterator member = members.begin(); member != members.end(); ++member) {
+                const state_t& needs = (*member)->dependencies();
+                for (state_t::const_iterator it = needs.begin(); it != needs.end(); ++it) {
+                    state_t::const_iterator made = changes.find(it->key());
+                    if (made != changes.end()) {
+                        const bool present = !made->isForbidden() && made->sameValue(*it);
+                        if (present == it->isForbidden()) {
+                            return false;
+                        }
+                        continue;
+                    }
+                    state_t::const_iterator needed = dependencies.find(it->key());
+                    if (needed != dependencies.end() && *needed != *it) {
+                        return false;
+                    }
+                    dependencies.insert(*it);
+                }
+                const state_t& makes = (*member)->changes();
+                for (state_t::const_iterator it = makes.begin(); it != makes.end(); ++it) {
+                    changes.insert(*it);
+                }
+            }
+            out_result.dependencies(dependencies);
+            out_result.changes(changes);
+            return true;
+        }
+}
+
+WW::CompiledSteps::CompiledSteps(const stepstore_t& steps, const std::vector<members_t>& macros, WW::AttributeTable& table, const state_t& start)
+: attributes(table)
+, steps()
+, operations()
+, macroBase(0)
+, macroSteps()
+, macroMembers()
+, index()
+, stepTable()
+, nonNegativeCosts(true)
+, keyCost()
+, reachable()
+, dominance()
+{
+    for (stepstore_t::const_iterator it = steps.begin(); it != steps.end(); ++it) {
+        nonNegativeCosts = nonNegativeCosts && static_cast<int>(it->cost()) >= 0; // as the solver sums them
+        index[&*it] = this->steps.size();
+        this->steps.push_back(&*it);
+        operations.push_back(table.intern(it->operation()));
+    }
+    macroBase = this->steps.size();
+    for (std::vector<members_t>::const_iterator it = macros.begin(); it != macros.end(); ++it) {
+        addMacro(*it);
+    }
+    stepTable.assign(operations);
+    findDominated(this->steps, operations, dominance);
+    reachable.assign(start, operations);
+
+    keyCost.assign(table.keyCount(), std::numeric_limits<int>::max());
+    for (size_t i = 0; i < operations.size(); ++i) {
+        const state_t& changes = operations[i].changes();
+        for (state_t::const_iterator it = changes.begin(); it != changes.end(); ++it) {
+            keyCost[it->key()] = std::min(keyCost[it->key()], static_cast<int>(this->steps[i]->cost()));
+        }
+    }
+}
+
+/** Add the macro step running `members` in turn, unless they can not
+ * run one after another from any state
+ */
+void
+WW::CompiledSteps::addMacro(const members_t& members)
+{
+    std::vector<const operation_t*> memberOperations;
+    std::string name;
+    unsigned int cost = 0;
+    for (members_t::const_iterator it = members.begin(); it != members.end(); ++it) {
+        memberOperations.push_back(&operation(**it));
+        name += (name.empty() ? "" : " + ") + (*it)->short_desc();
+        cost += (*it)->cost();
+    }
+    operation_t combined;
+    if (!combineOperations(memberOperations, combined)) {
+        return;
+    }
+    macroSteps.push_back(WW::TestStep());
+    WW::TestStep& step = macroSteps.back();
+    step.short_desc(name);
+    step.cost(cost);
+    index[&step] = steps.size();
+    steps.push_back(&step);
+    operations.push_back(combined);
+    macroMembers.push_back(members);
+}
+
+std::string
+WW::hashText(const std::string& text)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (std::string::const_iterator it = text.begin(); it != text.end(); ++it) {
+        hash = (hash ^ static_cast<unsigned char>(*it)) * 1099511628211ULL;
+    }
+    std::ostringstream result;
+    result << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return result.str();
+}
+
+std::string
+WW::signature(const WW::TestStep& step)
+{
+    std::ostringstream definition;
+    definition << step.short_desc() << '\n' << step.operation().dependencies() << '\n' << step.operation().changes() << '\n'
+        << step.cost() << '\n' << step.description() << '\n' << step.script();
+    return hashText(definition.str()) + ':' + step.short_desc();
+}
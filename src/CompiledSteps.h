@@ -0,0 +1,87 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_COMPILEDSTEPS_HEADER
+#define INCLUDE_WW_COMPILEDSTEPS_HEADER
+
+#include "AttributeTable.h"
+#include "Reachability.h"
+#include "StepTable.h"
+#include "TestStep.h"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace WW
+{
+    typedef std::list<TestStep> stepstore_t;
+    typedef AttributeTable::ids_t state_t; // interned attributes used by the solver
+    typedef AttributeTable::id_operation_t operation_t;
+
+    struct StateHash
+    {
+        size_t operator()(const state_t& state) const { return state.hash(); }
+    };
+
+    /** Whether a step is ever worth considering, when another makes the
+     * same changes, is valid whenever it is, and is cheaper, or as cheap and
+     * earlier so preferred anyway.
+     */
+    enum dominance_t {
+        UNDOMINATED,
+        DOMINATED,  // never on a cheapest path through the states
+        DUPLICATED  // nor chosen by a solve with no chain; the other needs the very same dependencies
+    };
+
+    /** The available steps in the interned form used by the solver.
+     *
+     * Built once per calculate() and only read thereafter, so a single
+     * instance is shared by every solver thread.
+     */
+    struct CompiledSteps
+    {
+        typedef std::vector<const TestStep*> members_t;
+
+        CompiledSteps(const stepstore_t& steps, const std::vector<members_t>& macros, AttributeTable& table, const state_t& start);
+
+        const AttributeTable& attributes;
+        std::vector<const TestStep*> steps; // in store order, then the macro steps
+        std::vector<operation_t> operations; // interned, parallel to `steps`
+        size_t macroBase; // index of the first macro step
+        std::list<TestStep> macroSteps;
+        std::vector<members_t> macroMembers; // by index less macroBase
+        std::unordered_map<const TestStep*, size_t> index;
+        StepTable stepTable; // bitmasks and provider index of `operations`
+        bool nonNegativeCosts; // so a step's own cost is a lower bound on any solution using it
+        std::vector<int> keyCost; // cheapest step changing each attribute key, by key id
+        Reachability reachable; // from the start state
+        std::vector<dominance_t> dominance; // by step
+
+        const operation_t& operation(const TestStep& step) const { return operations[index.find(&step)->second]; }
+        bool isMacro(size_t step) const { return step >= macroBase; }
+
+    private:
+        void addMacro(const members_t& members);
+
+    private: // forbid copy and assignment
+        CompiledSteps(const CompiledSteps& copy);
+        CompiledSteps& operator=(const CompiledSteps& copy);
+    };
+
+    /** A hash of `text` as sixteen hex digits; FNV-1a, so it is the same
+     * from one build to the next
+     */
+    std::string hashText(const std::string& text);
+
+    /** Identifies a step by its short description, along with a hash of its
+     * whole definition, so a macro step learned from it can tell whether it
+     * has changed since.  Whether it is required is not part of it.
+     */
+    std::string signature(const TestStep& step);
+}
+
+#endif // INCLUDE_WW_COMPILEDSTEPS_HEADER
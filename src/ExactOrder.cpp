@@ -0,0 +1,280 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "ExactOrder.h"
+
+#include "Solver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <mutex>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+typedef WW::state_t state_t;
+typedef WW::operation_t operation_t;
+
+namespace {
+
+    /** Required steps ordered exactly at most, whatever limit is asked
+     * for; the table has an entry for every subset of them
+     */
+    const size_t EXACT_STEPS_MAX = 20;
+    /** States held by the table at most before exact ordering gives up */
+    const size_t EXACT_STATES_MAX = 1 << 24;
+
+    /** The cheapest way found to run a subset of the steps which ends in a
+     * particular state
+     */
+    struct ExactEntry
+    {
+        ExactEntry() : state(0), cost(0), parent(0), last(0) {}
+        uint32_t state; // as numbered by ExactStates
+        int cost;
+        uint32_t parent; // the entry of the subset without `last`, before it ran
+        uint32_t last; // the step run last
+    };
+
+    typedef std::vector<ExactEntry> exact_entries_t;
+
+    /** What running a step leads to from some state, as worked out by solve() */
+    struct ExactTransition
+    {
+        ExactTransition() : known(false), failed(false), cost(0), after(0) {}
+        bool known;
+        bool failed;
+        int cost; // of the step along with the steps needed before it
+        uint32_t after;
+    };
+
+    /** The states reached while ordering exactly, each given a number so the
+     * table need not hold copies of them
+     */
+    class ExactStates
+    {
+    public:
+        ExactStates() : m_mutex(), m_states(), m_numbers() {}
+
+    private: // forbid copy and assignment
+        ExactStates(const ExactStates& copy);
+        ExactStates& operator=(const ExactStates& copy);
+
+    public:
+        uint32_t number(const state_t& state) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::pair<std::unordered_map<state_t, uint32_t, WW::StateHash>::iterator, bool> it = m_numbers.insert(std::make_pair(state, m_states.size()));
+            if (it.second) {
+                m_states.push_back(state);
+            }
+            return it.first->second;
+        }
+        state_t state(uint32_t number) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_states[number];
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::vector<state_t> m_states;
+        std::unordered_map<state_t, uint32_t, WW::StateHash> m_numbers;
+    };
+
+    /** What each thread keeps while ordering exactly, so that it need only
+     * lock ExactStates for a state it has not met before.
+     *
+     * A solve may run other subsets' tasks on the same thread while it
+     * waits for candidates it has forked, so a task's slots are its own,
+     * apart from those of any task suspended beneath it, and nothing holds
+     * on to a transition across a solve.
+     */
+    struct ExactWorker
+    {
+        ExactWorker() : transitions(), slots(), nesting(0) {}
+        std::vector<ExactTransition> transitions; // by state, then step
+        std::vector<std::vector<uint32_t> > slots; // by nesting, then state, one past its entry in the subset being worked out
+        size_t nesting; // tasks in progress on the thread, each suspended beneath the next
+    };
+
+    /** Takes the next level of slots of a worker for the lifetime of the object */
+    class ExactNesting
+    {
+    public:
+        explicit ExactNesting(ExactWorker& worker)
+            : m_worker(worker)
+            , m_level(worker.nesting++)
+            {
+                if (m_level == worker.slots.size()) {
+                    worker.slots.push_back(std::vector<uint32_t>());
+                }
+            }
+        ~ExactNesting() { --m_worker.nesting; }
+
+    private: // forbid copy and assignment
+        ExactNesting(const ExactNesting& copy);
+        ExactNesting& operator=(const ExactNesting& copy);
+
+    public:
+        std::vector<uint32_t>& slots() { return m_worker.slots[m_level]; }
+
+    private:
+        ExactWorker& m_worker;
+        size_t m_level;
+    };
+
+    ExactTransition
+        exactTransition(uint32_t from, size_t last, const std::vector<const WW::TestStep*>& steps, ExactStates& states, WW::SolveContext& context, ExactWorker& worker)
+        {
+            const size_t index = from * steps.size() + last;
+            if (index < worker.transitions.size() && worker.transitions[index].known) {
+                return worker.transitions[index];
+            }
+            WW::ScratchList scratch(context);
+            WW::StepList& solution = scratch.list();
+            const WW::TestStep& step = *steps[last];
+            const operation_t& operation = context.operation(step);
+            state_t state = states.state(from);
+            ExactTransition transition;
+            transition.known = true;
+            transition.cost = WW::solve(state, operation.dependencies(), context, solution);
+            transition.failed = solution.empty() && transition.cost > 0; // empty solution means failure
+            transition.cost += step.cost();
+            WW::applyState(state, solution, context);
+            operation.modify(state);
+            transition.after = states.number(state);
+            if (index >= worker.transitions.size()) {
+                worker.transitions.resize((from + 1) * steps.size());
+            }
+            worker.transitions[index] = transition;
+            return transition;
+        }
+
+    /** Order the `pending` steps so that the cost is the least possible
+     * when each is solved for alone, as solveForSequence() does.
+     *
+     * This is the Held-Karp dynamic program over subsets of the steps, with
+     * the table indexed by the bitset of the subset.  What running another
+     * step costs depends on the state it starts in rather than on the step
+     * run before, so each subset keeps the cheapest way to reach each state
+     * it can end in, rather than each step it can end with.  Subsets of
+     * the same size depend only on smaller ones, so each size is worked out
+     * in parallel.
+     *
+     * Returns false if the table would hold more than `EXACT_STATES_MAX`
+     * states, `deadline` passes first, or no order can run every step.
+     */
+    bool
+        orderExactly(const state_t& state, const WW::StepList& pending, WW::SolverThreads& threads, const WW::Deadline& deadline, WW::StepList& out_order)
+        {
+            std::vector<const WW::TestStep*> steps;
+            for (WW::StepList::const_iterator it = pending.begin(); it != pending.end(); ++it) {
+                steps.push_back(&*it);
+            }
+            const size_t count = steps.size();
+            ExactStates states;
+            std::vector<exact_entries_t> table(size_t(1) << count);
+            table[0].push_back(ExactEntry());
+            table[0][0].state = states.number(state);
+            std::vector<std::vector<size_t> > sizes(count + 1);
+            for (size_t subset = 1; subset < table.size(); ++subset) {
+                sizes[std::bitset<EXACT_STEPS_MAX>(subset).count()].push_back(subset);
+            }
+
+            std::vector<ExactWorker> workers(threads.pool().size());
+            std::atomic<size_t> held(1);
+            std::atomic<bool> abandoned(false);
+            for (size_t size = 1; size <= count && !abandoned; ++size) {
+                const std::vector<size_t>& subsets = sizes[size];
+                threads.pool().run(subsets.size(), [&](size_t index, unsigned int worker) {
+                    if (abandoned || deadline.passed()) {
+                        abandoned = true;
+                        return;
+                    }
+                    WW::SolveContext& context = threads.context(worker);
+                    WW::ScopedSearch search(context, 0);
+                    ExactWorker& local = workers[worker];
+                    ExactNesting nesting(local);
+                    const size_t subset = subsets[index];
+                    exact_entries_t& reached = table[subset];
+                    for (size_t last = 0; last < count; ++last) {
+                        const size_t bit = size_t(1) << last;
+                        if ((subset & bit) == 0) {
+                            continue;
+                        }
+                        const exact_entries_t& before = table[subset & ~bit];
+                        for (size_t parent = 0; parent < before.size(); ++parent) {
+                            const ExactTransition transition = exactTransition(before[parent].state, last, steps, states, context, local);
+                            if (transition.failed) {
+                                continue;
+                            }
+                            std::vector<uint32_t>& slots = nesting.slots();
+                            if (transition.after >= slots.size()) {
+                                slots.resize(transition.after + 1, 0);
+                            }
+                            uint32_t& slot = slots[transition.after];
+                            const int cost = before[parent].cost + transition.cost;
+                            if (slot == 0) {
+                                reached.push_back(ExactEntry());
+                                slot = reached.size();
+                            }
+                            else if (cost >= reached[slot - 1].cost) {
+                                continue;
+                            }
+                            ExactEntry& entry = reached[slot - 1];
+                            entry.state = transition.after;
+                            entry.cost = cost;
+                            entry.parent = parent;
+                            entry.last = last;
+                        }
+                    }
+                    for (exact_entries_t::const_iterator it = reached.begin(); it != reached.end(); ++it) {
+                        nesting.slots()[it->state] = 0;
+                    }
+                    if ((held += reached.size()) > EXACT_STATES_MAX) {
+                        abandoned = true;
+                    }
+                });
+            }
+
+            const exact_entries_t& all = table.back();
+            if (abandoned || all.empty()) {
+                return false;
+            }
+            size_t cheapest = 0;
+            for (size_t entry = 1; entry < all.size(); ++entry) {
+                if (all[entry].cost < all[cheapest].cost) {
+                    cheapest = entry;
+                }
+            }
+            out_order.clear();
+            for (size_t subset = table.size() - 1, entry = cheapest; subset != 0; ) {
+                const ExactEntry& found = table[subset][entry];
+                out_order.insert(out_order.begin(), *steps[found.last]);
+                subset &= ~(size_t(1) << found.last);
+                entry = found.parent;
+            }
+            return true;
+        }
+}
+
+bool
+WW::solveExactly(const state_t& state, const WW::StepList& pending, WW::SolverThreads& threads, size_t limit, const WW::Deadline& deadline, WW::StepList& out_order, WW::StepList& out_plan, int& out_cost, WW::OrderStats& out_stats)
+{
+    if (pending.size() > std::min(limit, EXACT_STEPS_MAX)) {
+        return false;
+    }
+    ++out_stats.exactTried;
+    if (!orderExactly(state, pending, threads, deadline, out_order)) {
+        out_stats.cutShort += deadline.passed() ? 1 : 0;
+        return false;
+    }
+    ++out_stats.exact;
+    WW::SolveContext& context = threads.context(threads.pool().worker());
+    out_cost = WW::solveForSequence(state, out_order.begin(), out_order.end(), context, out_plan, false);
+    WW::StepList guided(out_order);
+    WW::takeIfCheaper(state, guided, context, out_order, out_plan, out_cost);
+    return true;
+}
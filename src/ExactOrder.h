@@ -0,0 +1,26 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_EXACTORDER_HEADER
+#define INCLUDE_WW_EXACTORDER_HEADER
+
+#include "CompiledSteps.h"
+#include "Ordering.h"
+#include "StepList.h"
+
+#include <cstddef>
+
+namespace WW
+{
+    class SolverThreads;
+
+    /** Plan the order the `pending` steps have exactly, if there are few
+     * enough of them; false if not.  Exact ordering finds no order until it
+     * has finished, so gives up if `deadline` passes first.
+     */
+    bool solveExactly(const state_t& state, const StepList& pending, SolverThreads& threads, size_t limit, const Deadline& deadline, StepList& out_order, StepList& out_plan, int& out_cost, OrderStats& out_stats);
+}
+
+#endif // INCLUDE_WW_EXACTORDER_HEADER
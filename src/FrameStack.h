@@ -0,0 +1,64 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_FRAMESTACK_HEADER
+#define INCLUDE_WW_FRAMESTACK_HEADER
+
+#include <memory>
+#include <vector>
+
+namespace WW
+{
+    /** A stack of frames for an iterative algorithm, which recycles them.
+     *
+     * A popped frame is kept for the next push, along with any memory its
+     * members have acquired, so once the stack has reached its working depth
+     * pushing a frame allocates nothing.  Frames are never moved, so a
+     * reference to one stays valid while others are pushed above it.
+     *
+     * The frame type must provide `void reset()`, called on every push, which
+     * returns it to its initial state without releasing its memory.
+     */
+    template <class _Frame>
+        class FrameStack
+        {
+        public:
+            typedef _Frame frame_t;
+
+        public:
+            ~FrameStack() {}
+            FrameStack() : m_frames(), m_size(0) {}
+
+        private: // forbid copy and assignment
+            FrameStack(const FrameStack& copy);
+            FrameStack& operator=(const FrameStack& copy);
+
+        public:
+            frame_t& push() {
+                if (m_size == m_frames.size()) {
+                    m_frames.push_back(std::unique_ptr<frame_t>(new frame_t));
+                }
+                frame_t& result = *m_frames[m_size++];
+                result.reset();
+                return result;
+            }
+            void pop() { --m_size; }
+            /** Pop frames until only `size` remain */
+            void popTo(size_t size) { m_size = (size < m_size) ? size : m_size; }
+            frame_t& top() { return *m_frames[m_size - 1]; }
+            frame_t& operator[](size_t index) { return *m_frames[index]; }
+
+            bool empty() const { return m_size == 0; }
+            size_t size() const { return m_size; }
+            /** Frames allocated; the deepest the stack has been */
+            size_t allocated() const { return m_frames.size(); }
+
+        private:
+            std::vector<std::unique_ptr<frame_t> > m_frames;
+            size_t m_size;
+        };
+}
+
+#endif // INCLUDE_WW_FRAMESTACK_HEADER
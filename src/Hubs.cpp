@@ -0,0 +1,140 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "Hubs.h"
+
+#include "Solver.h"
+
+#include <algorithm>
+
+typedef WW::state_t state_t;
+
+namespace {
+
+    /** The dependencies needed by the most steps which can run, up to
+     * `count` of them, most needed first; dependencies needed by a single
+     * step are no hub.
+     */
+    void
+        findHubTargets(const WW::CompiledSteps& compiled, size_t count, std::vector<state_t>& out_targets)
+        {
+            out_targets.clear();
+            std::vector<std::pair<size_t, const state_t*> > needed; // steps needing, dependencies; in order of first need
+            std::unordered_map<state_t, size_t, WW::StateHash> found;
+            for (size_t i = 0; i < compiled.macroBase; ++i) {
+                const state_t& dependencies = compiled.operations[i].dependencies();
+                if (dependencies.empty() || !compiled.reachable.canRun(i)) {
+                    continue;
+                }
+                std::pair<std::unordered_map<state_t, size_t, WW::StateHash>::iterator, bool> inserted = found.insert(std::make_pair(dependencies, needed.size()));
+                if (inserted.second) {
+                    needed.push_back(std::make_pair(0, &dependencies));
+                }
+                ++needed[inserted.first->second].first;
+            }
+            std::stable_sort(needed.begin(), needed.end(), [](const std::pair<size_t, const state_t*>& lhs, const std::pair<size_t, const state_t*>& rhs) {
+                return lhs.first > rhs.first;
+            });
+            for (size_t i = 0; i < needed.size() && i < count && needed[i].first > 1; ++i) {
+                out_targets.push_back(*needed[i].second);
+            }
+        }
+}
+
+WW::Hub&
+WW::HubTable::add(const state_t& target, SolveContext& context)
+{
+    std::pair<std::unordered_map<state_t, size_t, StateHash>::iterator, bool> inserted = byTarget.insert(std::make_pair(target, hubs.size()));
+    if (inserted.second) {
+        hubs.push_back(Hub());
+        hubs.back().target = target;
+        hubs.back().relevant = relevance(target, context);
+    }
+    return hubs[inserted.first->second];
+}
+
+const WW::Hub*
+WW::HubTable::find(const state_t& target) const
+{
+    std::unordered_map<state_t, size_t, StateHash>::const_iterator found = byTarget.find(target);
+    return (found == byTarget.end()) ? 0 : &hubs[found->second];
+}
+
+const WW::HubPlan*
+WW::HubTable::find(const state_t& state, const state_t& target) const
+{
+    const Hub* hub = find(target);
+    if (hub == 0) {
+        return 0;
+    }
+    state_t reduced;
+    project(state, hub->relevant, reduced);
+    std::unordered_map<state_t, HubPlan, StateHash>::const_iterator found = hub->plans.find(reduced);
+    return (found == hub->plans.end()) ? 0 : &found->second;
+}
+
+size_t
+WW::HubTable::planCount() const
+{
+    size_t result = 0;
+    for (std::vector<Hub>::const_iterator it = hubs.begin(); it != hubs.end(); ++it) {
+        result += it->plans.size();
+    }
+    return result;
+}
+
+void
+WW::computeHubs(const state_t& start, size_t count, WW::SolverThreads& threads, const WW::CompiledSteps& compiled, WW::HubTable& out_table)
+{
+    std::vector<state_t> targets;
+    findHubTargets(compiled, count, targets);
+    std::vector<state_t> states(1, start);
+    for (std::vector<state_t>::const_iterator it = targets.begin(); it != targets.end(); ++it) {
+        state_t state;
+        for (state_t::const_iterator attr = it->begin(); attr != it->end(); ++attr) {
+            if (!attr->isForbidden()) {
+                state.insert(*attr);
+            }
+        }
+        states.push_back(state);
+    }
+
+    struct Search
+    {
+        WW::Hub* hub;
+        const state_t* state; // reduced to the keys relevant to the hub
+        WW::HubPlan* plan;
+    };
+    std::vector<Search> searches;
+    state_t reduced;
+    for (std::vector<state_t>::const_iterator target = targets.begin(); target != targets.end(); ++target) {
+        out_table.add(*target, threads.context(0));
+    }
+    for (std::vector<WW::Hub>::iterator hub = out_table.hubs.begin(); hub != out_table.hubs.end(); ++hub) {
+        for (std::vector<state_t>::const_iterator it = states.begin(); it != states.end(); ++it) {
+            WW::project(*it, hub->relevant, reduced);
+            std::pair<std::unordered_map<state_t, WW::HubPlan, WW::StateHash>::iterator, bool> inserted = hub->plans.insert(std::make_pair(reduced, WW::HubPlan()));
+            if (inserted.second) {
+                Search search = { &*hub, &inserted.first->first, &inserted.first->second };
+                searches.push_back(search);
+            }
+        }
+    }
+
+    std::vector<char> found(searches.size(), false);
+    threads.pool().run(searches.size(), [&](size_t index, unsigned int worker) {
+        const Search& search = searches[index];
+        WW::SolveContext& context = threads.context(worker);
+        WW::ScopedSearch scope(context, 0);
+        found[index] = WW::searchStates(*search.state, search.hub->target, context, search.plan->plan, WW::UNBOUNDED, search.plan->cost)
+            && (search.plan->cost == 0 || !search.plan->plan.empty());
+    });
+    for (size_t index = 0; index < searches.size(); ++index) {
+        if (!found[index]) {
+            const state_t state = *searches[index].state;
+            searches[index].hub->plans.erase(state);
+        }
+    }
+}
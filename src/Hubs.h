@@ -0,0 +1,70 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_HUBS_HEADER
+#define INCLUDE_WW_HUBS_HEADER
+
+#include "CompiledSteps.h"
+#include "StateSearch.h"
+#include "StepList.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace WW
+{
+    class SolverThreads;
+    struct SolveContext;
+
+    /** The cheapest plan from a hub state to a hub target */
+    struct HubPlan
+    {
+        HubPlan() : cost(0), plan() {}
+        int cost;
+        StepList plan;
+    };
+
+    /** A hub target, with the cheapest plans to it from each hub state */
+    struct Hub
+    {
+        Hub() : target(), relevant(), plans() {}
+        state_t target;
+        Relevance relevant;
+        std::unordered_map<state_t, HubPlan, StateHash> plans; // by state, reduced to the relevant keys
+    };
+
+    /** Cheapest plans between the hub states, worked out once by the state
+     * space search before anything else is solved, and only read thereafter.
+     *
+     * A hub target is a set of dependencies which many steps share, and its
+     * hub state is where just those of its attributes which are present
+     * hold.  The start state is a hub state too.  Since whether a state can
+     * reach a target depends only on its relevant keys, a plan holds for any
+     * state which agrees with the hub state on those.
+     */
+    struct HubTable
+    {
+        HubTable() : hubs(), byTarget() {}
+
+        std::vector<Hub> hubs;
+        std::unordered_map<state_t, size_t, StateHash> byTarget; // index into `hubs`
+
+        Hub& add(const state_t& target, SolveContext& context);
+        const Hub* find(const state_t& target) const;
+        const HubPlan* find(const state_t& state, const state_t& target) const;
+        size_t planCount() const;
+    };
+
+    /** Work out the hub table for the `count` hub targets, with a plan to
+     * each from `start` and from every hub state.  The state space search
+     * finds each plan, so they are the cheapest there are.  States which
+     * reduce to the same for a target share their plan, so are searched
+     * once; the searches are independent, so run in parallel.  A plan which
+     * can not be found, or not before the search is abandoned, is left out.
+     */
+    void computeHubs(const state_t& start, size_t count, SolverThreads& threads, const CompiledSteps& compiled, HubTable& out_table);
+}
+
+#endif // INCLUDE_WW_HUBS_HEADER
@@ -0,0 +1,92 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "Insertion.h"
+
+#include "Solver.h"
+
+void
+WW::evaluateInsertionPoint(const WW::TestStep& step, WW::StepList::const_iterator it, WW::StepList::const_iterator end, size_t position, const SequenceWalk& walk, SolveContext& context, InsertionCost& out_result)
+{
+    ScratchList scratch(context);
+    WW::StepList& solution = scratch.list();
+    state_t state = walk.states[position];
+    int cost = walk.costs[position] + solve(state, context.operation(step).dependencies(), context, solution);
+    if (cost == 0 || !solution.empty()) {
+        applyState(state, solution, context);
+        cost += step.cost();
+        context.operation(step).modify(state);
+        bool failed = false;
+        cost += solveSuffix(state, it, end, position, walk, context, failed);
+        out_result.cost = cost;
+        out_result.valid = !failed;
+    }
+}
+
+WW::StepList::iterator
+WW::bestInsertionPoint(const state_t& startState, WW::StepList& sequence, const WW::TestStep& step, SolverThreads& threads)
+{
+    // DBGOUT("bestInsertionPoint(startState, sequence=" << sequence << ", step=" << step << ", steps)");
+    SolveContext& context = threads.context(threads.pool().worker());
+    ScratchList scratch(context);
+    WW::StepList& solution = scratch.list();
+    WW::StepList::iterator insert_before = sequence.end();
+    int cheapest = 0;
+
+    // Work out the state before every position of the existing
+    // sequence first; evaluating an insertion point then only needs
+    // to solve forward until the state converges with these.
+    SequenceWalk walk;
+    walkSequence(startState, sequence, context, walk);
+
+    // Each position is independent of the others, so they are
+    // evaluated in parallel, then compared in sequence order so that
+    // the earliest of equally cheap positions is chosen.
+    std::vector<WW::StepList::iterator> positions;
+    positions.reserve(sequence.size());
+    for (WW::StepList::iterator it = sequence.begin(); it != sequence.end(); ++it) {
+        positions.push_back(it);
+    }
+    std::vector<InsertionCost> costs(positions.size());
+    WW::StepList::const_iterator end = sequence.end();
+    threads.pool().run(positions.size(), [&](size_t position, unsigned int worker) {
+        ScopedSearch search(threads.context(worker), 0);
+        evaluateInsertionPoint(step, positions[position], end, position, walk, threads.context(worker), costs[position]);
+    });
+
+    for (size_t position = 0; position < positions.size(); ++position) {
+        if (costs[position].valid && (insert_before == sequence.end() || costs[position].cost < cheapest)) {
+            cheapest = costs[position].cost;
+            insert_before = positions[position];
+        }
+    }
+    // We finally get to work out whether the best insertion point is right at the end.
+    {
+        int accumulated_cost = walk.costs.back();
+        int cost = solve(walk.states.back(), context.operation(step).dependencies(), context, solution);
+        if (cost == 0 || !solution.empty()) {
+            accumulated_cost += cost + step.cost();
+            if (accumulated_cost < cheapest) {
+                insert_before = sequence.end();
+            }
+        }
+    }
+    return insert_before;
+}
+
+bool
+WW::orderByInsertion(const state_t& state, const WW::StepList& pending, SolverThreads& threads, const WW::Deadline& deadline, WW::StepList& out_order, Progress& progress)
+{
+    out_order.clear();
+    bool finished = true;
+    for (WW::StepList::const_iterator it = pending.begin(); it != pending.end(); ++it)
+    {
+        progress.place();
+        finished = finished && !deadline.passed();
+        WW::StepList::iterator insert_point = finished ? bestInsertionPoint(state, out_order, *it, threads) : out_order.end();
+        out_order.insert(insert_point, *it);
+    }
+    return finished;
+}
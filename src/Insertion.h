@@ -0,0 +1,44 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_INSERTION_HEADER
+#define INCLUDE_WW_INSERTION_HEADER
+
+#include "CompiledSteps.h"
+#include "Ordering.h"
+#include "StepList.h"
+
+namespace WW
+{
+    class Progress;
+    class SolverThreads;
+    struct SequenceWalk;
+    struct SolveContext;
+
+    /** The outcome of inserting a step before one position of a sequence */
+    struct InsertionCost
+    {
+        InsertionCost() : cost(0), valid(false) {}
+        int cost;
+        bool valid;
+    };
+
+    /** Cost of the sequence `walk` was made for with `step` inserted before
+     * `position`, solving no further than the point the insertion rejoins
+     * the walk */
+    void evaluateInsertionPoint(const TestStep& step, StepList::const_iterator it, StepList::const_iterator end, size_t position, const SequenceWalk& walk, SolveContext& context, InsertionCost& out_result);
+
+    /** The point of `sequence` before which inserting `step` costs least,
+     * or its end if the step can be placed nowhere */
+    StepList::iterator bestInsertionPoint(const state_t& startState, StepList& sequence, const TestStep& step, SolverThreads& threads);
+
+    /** Order the `pending` steps by inserting each in turn at its best
+     * point.  Those not yet inserted once `deadline` has passed are put at
+     * the end in turn instead; false if any were.
+     */
+    bool orderByInsertion(const state_t& state, const StepList& pending, SolverThreads& threads, const Deadline& deadline, StepList& out_order, Progress& progress);
+}
+
+#endif // INCLUDE_WW_INSERTION_HEADER
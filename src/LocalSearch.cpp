@@ -0,0 +1,196 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "LocalSearch.h"
+
+#include "Solver.h"
+#include "TestException.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+typedef WW::state_t state_t;
+
+namespace {
+
+    typedef std::vector<const WW::TestStep*> order_t;
+
+    /** A change to an order of the required steps, tried by local search */
+    struct OrderMove
+    {
+        enum Kind { RELOCATE, REVERSE };
+
+        OrderMove() : kind(RELOCATE), first(0), last(0), to(0), cost(0), valid(false) {}
+        Kind kind;
+        size_t first; // of the items moved or reversed
+        size_t last; // one past them
+        size_t to; // the position they are moved before, outside them; `first` when reversed
+        int cost; // of the order once the move is made
+        bool valid;
+    };
+
+    /** Items moved at most by an or-opt move */
+    const size_t OR_OPT_LIMIT = 3;
+    /** Items moved at most by a block relocation */
+    const size_t BLOCK_LIMIT = 12;
+    /** Moves local search costs at once, in parallel.  This is fixed rather
+     * than one per thread, so the moves tried are the same however many
+     * threads there are.
+     */
+    const size_t LOCAL_SEARCH_BATCH = 16;
+    /** Batches in a row which find nothing cheaper before local search stops */
+    const size_t LOCAL_SEARCH_PATIENCE = 32;
+
+    OrderMove
+        randomMove(std::mt19937& random, size_t size)
+        {
+            OrderMove move;
+            size_t length = 0;
+            switch (random() % 3) {
+                case 0: // or-opt: a few items move elsewhere
+                    length = 1 + random() % std::min(OR_OPT_LIMIT, size - 1);
+                    break;
+                case 1: // a block of items moves elsewhere
+                    length = 1 + random() % std::min(BLOCK_LIMIT, size - 1);
+                    break;
+                default: // 2-opt: a stretch of items is reversed
+                    move.kind = OrderMove::REVERSE;
+                    length = 2 + random() % (size - 1);
+                    break;
+            }
+            move.first = random() % (size - length + 1);
+            move.last = move.first + length;
+            move.to = move.first;
+            if (move.kind == OrderMove::RELOCATE) {
+                // anywhere but where they are already
+                size_t to = random() % (size - length);
+                move.to = (to < move.first) ? to : to + length + 1;
+            }
+            return move;
+        }
+
+    void
+        applyMove(const OrderMove& move, order_t& order)
+        {
+            if (move.kind == OrderMove::REVERSE) {
+                std::reverse(order.begin() + move.first, order.begin() + move.last);
+            }
+            else if (move.to < move.first) {
+                std::rotate(order.begin() + move.to, order.begin() + move.first, order.begin() + move.last);
+            }
+            else {
+                std::rotate(order.begin() + move.first, order.begin() + move.last, order.begin() + move.to);
+            }
+        }
+
+    /** Cost the order `walk` was made for once `out_move` is made to it,
+     * solving for each item alone as solveForSequence() does.  Only the
+     * window of items the move rearranges is solved afresh, along with
+     * whatever follows it until the state rejoins `walk`.
+     */
+    void
+        evaluateMove(const order_t& order, const WW::SequenceWalk& walk, WW::SolveContext& context, OrderMove& out_move)
+        {
+            order_t moved(order);
+            applyMove(out_move, moved);
+            const size_t begin = std::min(out_move.first, out_move.to);
+            const size_t end = std::max(out_move.last, out_move.to);
+
+            WW::ScratchList scratch(context);
+            WW::StepList& solution = scratch.list();
+            state_t state = walk.states[begin];
+            int cost = walk.costs[begin];
+            for (size_t position = begin; position < moved.size(); ++position) {
+                if (position >= end && state == walk.states[position]) {
+                    cost += walk.costs.back() - walk.costs[position];
+                    break;
+                }
+                const WW::TestStep& step = *moved[position];
+                int item_cost = WW::solve(state, context.operation(step).dependencies(), context, solution);
+                if (solution.empty() && item_cost > 0) {
+                    return; // empty solution means failure
+                }
+                cost += item_cost + step.cost();
+                WW::applyState(state, solution, context);
+                context.operation(step).modify(state);
+            }
+            out_move.cost = cost;
+            out_move.valid = true;
+        }
+
+    /** walkSequence(), but false rather than throwing if some step of
+     * `sequence` can not be solved where it is
+     */
+    bool
+        walkable(const state_t& state, const WW::StepList& sequence, WW::SolveContext& context, WW::SequenceWalk& out_walk)
+        {
+            try {
+                WW::walkSequence(state, sequence, context, out_walk);
+            }
+            catch (const WW::TestException&) {
+                return false;
+            }
+            return true;
+        }
+}
+
+bool
+WW::improveOrder(const state_t& state, WW::StepList& order, WW::SolverThreads& threads, const OrderOptions& options, const Deadline& deadline, OrderStats& stats)
+{
+    if (order.size() < 2) {
+        return true;
+    }
+    WW::SolveContext& context = threads.context(threads.pool().worker());
+    std::mt19937 random(options.seed);
+    order_t current;
+    current.reserve(order.size());
+    for (WW::StepList::const_iterator it = order.begin(); it != order.end(); ++it) {
+        current.push_back(&*it);
+    }
+    WW::SequenceWalk walk;
+    if (!walkable(state, order, context, walk)) {
+        return true; // as with a move which fails, there is nothing to improve
+    }
+
+    std::vector<OrderMove> moves(LOCAL_SEARCH_BATCH);
+    size_t idle = 0;
+    while (idle < LOCAL_SEARCH_PATIENCE && !deadline.passed()) {
+        for (std::vector<OrderMove>::iterator it = moves.begin(); it != moves.end(); ++it) {
+            *it = randomMove(random, current.size());
+        }
+        threads.pool().run(moves.size(), [&](size_t index, unsigned int worker) {
+            WW::ScopedSearch search(threads.context(worker), 0);
+            evaluateMove(current, walk, threads.context(worker), moves[index]);
+        });
+        stats.tried += moves.size();
+
+        const OrderMove* cheapest = 0;
+        for (std::vector<OrderMove>::const_iterator it = moves.begin(); it != moves.end(); ++it) {
+            if (it->valid && it->cost < (cheapest == 0 ? walk.costs.back() : cheapest->cost)) {
+                cheapest = &*it;
+            }
+        }
+        if (cheapest == 0) {
+            ++idle;
+            continue;
+        }
+        order_t moved(current);
+        applyMove(*cheapest, moved);
+        WW::StepList improved;
+        for (order_t::const_iterator it = moved.begin(); it != moved.end(); ++it) {
+            improved.push_back(**it);
+        }
+        if (!walkable(state, improved, context, walk)) {
+            return true; // a solve the move needs was cut short by the depth limit
+        }
+        idle = 0;
+        ++stats.taken;
+        current.swap(moved);
+        order.clear();
+        order.splice(order.end(), improved);
+    }
+    return idle == LOCAL_SEARCH_PATIENCE;
+}
@@ -0,0 +1,29 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_LOCALSEARCH_HEADER
+#define INCLUDE_WW_LOCALSEARCH_HEADER
+
+#include "CompiledSteps.h"
+#include "Ordering.h"
+#include "StepList.h"
+
+namespace WW
+{
+    class SolverThreads;
+
+    /** Improve `order` by local search: batches of random or-opt moves,
+     * block relocations and 2-opt moves are costed, and the cheapest of a
+     * batch is made if it lowers the cost of the order.  This stops after
+     * `LOCAL_SEARCH_PATIENCE` batches in a row improve nothing, or once
+     * `deadline` has passed; only in the latter case, for which it returns
+     * false, can the outcome differ from one run to the next with the same
+     * seed.  An order which can not be walked, as walkSequence() would
+     * throw for, is left as it is.
+     */
+    bool improveOrder(const state_t& state, StepList& order, SolverThreads& threads, const OrderOptions& options, const Deadline& deadline, OrderStats& stats);
+}
+
+#endif // INCLUDE_WW_LOCALSEARCH_HEADER
@@ -0,0 +1,137 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "Macros.h"
+
+#include "Solver.h"
+
+#include <map>
+
+namespace {
+
+    /** Sub-plans with between these many steps may become macro steps */
+    const size_t MACRO_MIN_STEPS = 3;
+    const size_t MACRO_MAX_STEPS = 6;
+
+    /** Separate solves which must find a sub-plan for it to become a macro step */
+    const unsigned int MACRO_MIN_USES = 3;
+
+    /** Macro steps kept at most */
+    const size_t MACRO_LIMIT = 64;
+}
+
+void
+WW::recordSequence(const WW::Plan& solution, SolveContext& context)
+{
+    if (!context.threads.learnMacros() || solution.size() > MACRO_MAX_STEPS) {
+        return;
+    }
+    const CompiledSteps& compiled = context.compiled;
+    std::vector<size_t> sequence;
+    solution.forEach([&compiled, &sequence](const WW::TestStep& step) {
+        size_t index = compiled.index.find(&step)->second;
+        if (!compiled.isMacro(index)) {
+            sequence.push_back(index);
+            return;
+        }
+        const CompiledSteps::members_t& members = compiled.macroMembers[index - compiled.macroBase];
+        for (CompiledSteps::members_t::const_iterator member = members.begin(); member != members.end(); ++member) {
+            sequence.push_back(compiled.index.find(*member)->second);
+        }
+    });
+    if (sequence.size() >= MACRO_MIN_STEPS && sequence.size() <= MACRO_MAX_STEPS) {
+        ++context.sequences[sequence];
+    }
+}
+
+void
+WW::learnMacros(SolverThreads& threads, const CompiledSteps& compiled, std::vector<CompiledSteps::members_t>& out_learned)
+{
+    out_learned.clear();
+    std::map<std::vector<size_t>, unsigned int> uses; // ordered, so ties are settled the same way every time
+    for (unsigned int worker = 0; worker < threads.pool().size(); ++worker) {
+        const sequences_t& sequences = threads.context(worker).sequences;
+        for (sequences_t::const_iterator it = sequences.begin(); it != sequences.end(); ++it) {
+            uses[it->first] += it->second;
+        }
+    }
+    for (std::vector<CompiledSteps::members_t>::const_iterator it = compiled.macroMembers.begin(); it != compiled.macroMembers.end(); ++it) {
+        std::vector<size_t> sequence;
+        for (CompiledSteps::members_t::const_iterator member = it->begin(); member != it->end(); ++member) {
+            sequence.push_back(compiled.index.find(*member)->second);
+        }
+        uses.erase(sequence);
+    }
+
+    std::vector<std::pair<unsigned int, const std::vector<size_t>*> > ranked;
+    for (std::map<std::vector<size_t>, unsigned int>::const_iterator it = uses.begin(); it != uses.end(); ++it) {
+        if (it->second >= MACRO_MIN_USES) {
+            ranked.push_back(std::make_pair(it->second, &it->first));
+        }
+    }
+    std::stable_sort(ranked.begin(), ranked.end(), [](const std::pair<unsigned int, const std::vector<size_t>*>& lhs, const std::pair<unsigned int, const std::vector<size_t>*>& rhs) {
+        return lhs.first > rhs.first;
+    });
+    for (size_t i = 0; i < ranked.size() && compiled.macroMembers.size() + out_learned.size() < MACRO_LIMIT; ++i) {
+        CompiledSteps::members_t members;
+        for (std::vector<size_t>::const_iterator it = ranked[i].second->begin(); it != ranked[i].second->end(); ++it) {
+            members.push_back(compiled.steps[*it]);
+        }
+        out_learned.push_back(members);
+    }
+}
+
+void
+WW::expandMacros(WW::StepList& plan, const CompiledSteps& compiled)
+{
+    WW::StepList expanded;
+    expanded.reserve(plan.size());
+    for (WW::StepList::const_iterator it = plan.begin(); it != plan.end(); ++it) {
+        size_t index = compiled.index.find(&*it)->second;
+        if (!compiled.isMacro(index)) {
+            expanded.push_back(*it);
+            continue;
+        }
+        const CompiledSteps::members_t& members = compiled.macroMembers[index - compiled.macroBase];
+        for (CompiledSteps::members_t::const_iterator member = members.begin(); member != members.end(); ++member) {
+            expanded.push_back(**member);
+        }
+    }
+    plan.clear();
+    plan.splice(plan.end(), expanded);
+}
+
+size_t
+WW::resolveMacros(const stepstore_t& store, std::vector<macro_t>& macros, std::vector<CompiledSteps::members_t>& out_members)
+{
+    out_members.clear();
+    if (macros.empty()) {
+        return 0;
+    }
+    std::unordered_map<std::string, const WW::TestStep*> steps;
+    for (stepstore_t::const_iterator it = store.begin(); it != store.end(); ++it) {
+        steps[signature(*it)] = &*it;
+    }
+    size_t dropped = 0;
+    std::vector<macro_t>::iterator it = macros.begin();
+    while (it != macros.end()) {
+        CompiledSteps::members_t members;
+        for (macro_t::const_iterator member = it->begin(); member != it->end(); ++member) {
+            std::unordered_map<std::string, const WW::TestStep*>::const_iterator found = steps.find(*member);
+            if (found == steps.end()) {
+                break;
+            }
+            members.push_back(found->second);
+        }
+        if (members.size() != it->size() || members.empty()) {
+            it = macros.erase(it);
+            ++dropped;
+            continue;
+        }
+        out_members.push_back(members);
+        ++it;
+    }
+    return dropped;
+}
@@ -0,0 +1,44 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_MACROS_HEADER
+#define INCLUDE_WW_MACROS_HEADER
+
+#include "CompiledSteps.h"
+#include "Plan.h"
+#include "StepList.h"
+
+#include <string>
+#include <vector>
+
+namespace WW
+{
+    class SolverThreads;
+    struct SolveContext;
+
+    typedef std::vector<std::string> macro_t; // a macro step, as the signature of each member
+
+    /** Count a sub-plan towards its promotion to a macro step, if learning.
+     * Called once for each solve which finds it, since solves are memoized.
+     */
+    void recordSequence(const Plan& solution, SolveContext& context);
+
+    /** The sub-plans found by enough solves on every thread, most often
+     * found first, which are not macro steps already; no more than would
+     * take the macro steps to `MACRO_LIMIT`.
+     */
+    void learnMacros(SolverThreads& threads, const CompiledSteps& compiled, std::vector<CompiledSteps::members_t>& out_learned);
+
+    /** Replace each macro step of `plan` with its members */
+    void expandMacros(StepList& plan, const CompiledSteps& compiled);
+
+    /** The members of each of `macros`, found among the steps of `store`.
+     * A macro with a member which is no longer there, or whose definition
+     * has changed, is dropped from `macros`; returns how many were.
+     */
+    size_t resolveMacros(const stepstore_t& store, std::vector<macro_t>& macros, std::vector<CompiledSteps::members_t>& out_members);
+}
+
+#endif // INCLUDE_WW_MACROS_HEADER
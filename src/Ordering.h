@@ -0,0 +1,64 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_ORDERING_HEADER
+#define INCLUDE_WW_ORDERING_HEADER
+
+#include <chrono>
+#include <cstddef>
+
+namespace WW
+{
+    /** When the strategies ordering the required steps must stop and give
+     * the best they have found so far; an untimed deadline never passes.
+     * It is soft: strategies check it between the steps of their search,
+     * never within a solve, so one slow solve can overrun it.
+     */
+    class Deadline
+    {
+    public:
+        Deadline() : m_timed(false), m_time() {}
+        explicit Deadline(unsigned int milliseconds) : m_timed(true), m_time(std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds)) {}
+
+        bool passed() const { return m_timed && std::chrono::steady_clock::now() >= m_time; }
+
+    private:
+        bool m_timed;
+        std::chrono::steady_clock::time_point m_time;
+    };
+
+    /** How solveAll() orders the required steps */
+    struct OrderOptions
+    {
+        OrderOptions() : portfolio(false), exactLimit(0), beamWidth(1), searchTime(0), seed(0) {}
+        bool portfolio; // try every strategy at once, taking the cheapest
+        size_t exactLimit; // components with at most this many steps are ordered exactly
+        size_t beamWidth; // partial orders kept by the beam search; one inserts each step in turn
+        unsigned int searchTime; // milliseconds of local search improving each order; zero for none
+        unsigned int seed; // of the moves local search tries
+    };
+
+    /** Ways of ordering the required steps which the portfolio tries, in
+     * the order they win ties
+     */
+    enum Strategy { INSERTION, BEAM, LOCAL_SEARCH, EXACT, STRATEGY_COUNT };
+    const char* const STRATEGY_NAMES[STRATEGY_COUNT] = { "insertion", "beam search", "local search", "exact" };
+
+    /** How the order of a component, or of several, was found */
+    struct OrderStats
+    {
+        OrderStats() : exactTried(0), exact(0), before(0), after(0), tried(0), taken(0), wins(), cutShort(0) {}
+        size_t exactTried; // components small enough to order exactly
+        size_t exact; // of those, ordered exactly rather than given up on
+        int before; // cost of the plans for the orders first found, before local search
+        int after;
+        size_t tried; // moves by local search
+        size_t taken;
+        size_t wins[STRATEGY_COUNT]; // components each strategy of the portfolio won
+        size_t cutShort; // strategies of the portfolio stopped by its deadline
+    };
+}
+
+#endif // INCLUDE_WW_ORDERING_HEADER
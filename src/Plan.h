@@ -0,0 +1,198 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_PLAN_HEADER
+#define INCLUDE_WW_PLAN_HEADER
+
+#include "StepList.h"
+
+#include <memory>
+#include <vector>
+
+namespace WW
+{
+    /** An immutable sequence of steps, sharing its structure with the plans
+     * it was made from.  A plan of a single step, or the concatenation of two
+     * plans, is made by a PlanArena in constant time, and copying a plan only
+     * copies a pointer, so a solver may build and choose between many partial
+     * plans without copying any of them.
+     *
+     * A plan refers to nodes owned by the arena which made it, so is valid
+     * only until that arena forgets it.
+     */
+    class Plan
+    {
+    public:
+        struct Node
+        {
+            const TestStep* step; // of a plan of one step, or zero for a concatenation
+            const Node* first;
+            const Node* second;
+            size_t size;
+        };
+
+    public:
+        Plan() : m_root(0) {}
+        explicit Plan(const Node* root) : m_root(root) {}
+
+        bool empty() const { return m_root == 0; }
+        size_t size() const { return (m_root == 0) ? 0 : m_root->size; }
+        void clear() { m_root = 0; }
+        const Node* root() const { return m_root; }
+
+        /** Call `function` with each step of the plan in turn */
+        template <class _Function>
+            void forEach(_Function function) const;
+
+        /** Add the steps of the plan to the end of `out_result` */
+        void appendTo(StepList& out_result) const {
+            out_result.reserve(out_result.size() + size());
+            forEach([&out_result](const TestStep& step) { out_result.push_back(step); });
+        }
+
+    private:
+        const Node* m_root;
+    };
+
+    template <class _Function>
+        void
+        Plan::forEach(_Function function) const
+        {
+            // Concatenations are mostly nested on their first side, so the
+            // second sides still to visit are kept on a stack, which needs
+            // the heap only for a plan nested very deeply.
+            const size_t LOCAL_DEPTH = 64;
+            const Node* local[LOCAL_DEPTH];
+            std::vector<const Node*> deeper;
+            size_t depth = 0;
+            const Node* node = m_root;
+            while (node != 0) {
+                if (node->step == 0) {
+                    if (depth < LOCAL_DEPTH) {
+                        local[depth] = node->second;
+                    }
+                    else {
+                        deeper.push_back(node->second);
+                    }
+                    ++depth;
+                    node = node->first;
+                    continue;
+                }
+                function(*node->step);
+                if (depth == 0) {
+                    break;
+                }
+                --depth;
+                if (depth < LOCAL_DEPTH) {
+                    node = local[depth];
+                }
+                else {
+                    node = deeper.back();
+                    deeper.pop_back();
+                }
+            }
+        }
+
+    /** Makes plans, and owns their nodes until it is reset.  Nodes are
+     * allocated in blocks, which are kept for reuse when the arena is reset,
+     * so making a plan rarely allocates anything.  Not thread safe.
+     *
+     * The plans made since a mark may also be forgotten together, leaving
+     * those made before it, as a stack.
+     */
+    class PlanArena
+    {
+    public:
+        struct Mark
+        {
+            size_t block;
+            size_t used;
+        };
+
+    public:
+        ~PlanArena() {}
+        PlanArena() : m_blocks(), m_block(0), m_used(0) {}
+
+    private: // forbid copy and assignment
+        PlanArena(const PlanArena& copy);
+        PlanArena& operator=(const PlanArena& copy);
+
+    public:
+        /** A plan of the single step `step` */
+        Plan step(const TestStep& step) {
+            Plan::Node* node = allocate();
+            node->step = &step;
+            node->first = 0;
+            node->second = 0;
+            node->size = 1;
+            return Plan(node);
+        }
+
+        /** `first` followed by `second` */
+        Plan join(const Plan& first, const Plan& second) {
+            if (first.empty()) {
+                return second;
+            }
+            if (second.empty()) {
+                return first;
+            }
+            Plan::Node* node = allocate();
+            node->step = 0;
+            node->first = first.root();
+            node->second = second.root();
+            node->size = first.size() + second.size();
+            return Plan(node);
+        }
+
+        /** A plan of the steps in `steps` */
+        Plan copy(const StepList& steps) { return copy(steps.begin(), steps.end()); }
+
+        /** Forget every plan made so far, keeping the memory for those to come */
+        void reset() { m_block = 0; m_used = 0; }
+
+        /** The point reached, to be released back to */
+        Mark mark() const { Mark result = { m_block, m_used }; return result; }
+        /** Forget the plans made since `mark` */
+        void release(const Mark& mark) { m_block = mark.block; m_used = mark.used; }
+
+        /** Memory occupied by the nodes of the plans not yet forgotten */
+        size_t memoryUsed() const {
+            return (m_blocks.empty() ? 0 : m_block * BLOCK_NODES + m_used) * sizeof(Plan::Node);
+        }
+
+    private:
+        Plan copy(StepList::const_iterator begin, StepList::const_iterator end) {
+            // balanced, so the nesting grows only with the logarithm of the length
+            if (end - begin < 2) {
+                return (begin == end) ? Plan() : step(*begin);
+            }
+            StepList::const_iterator middle = begin + (end - begin) / 2;
+            Plan first = copy(begin, middle);
+            return join(first, copy(middle, end));
+        }
+
+        Plan::Node* allocate() {
+            if (m_blocks.empty() || m_used == BLOCK_NODES) {
+                if (!m_blocks.empty()) {
+                    ++m_block;
+                }
+                if (m_block == m_blocks.size()) {
+                    m_blocks.push_back(std::unique_ptr<Plan::Node[]>(new Plan::Node[BLOCK_NODES]));
+                }
+                m_used = 0;
+            }
+            return &m_blocks[m_block][m_used++];
+        }
+
+        static const size_t BLOCK_NODES = 4096;
+
+    private:
+        std::vector<std::unique_ptr<Plan::Node[]> > m_blocks;
+        size_t m_block; // in use
+        size_t m_used; // nodes of the block in use
+    };
+}
+
+#endif // INCLUDE_WW_PLAN_HEADER
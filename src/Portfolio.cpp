@@ -0,0 +1,134 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "Portfolio.h"
+
+#include "BeamSearch.h"
+#include "ExactOrder.h"
+#include "Insertion.h"
+#include "LocalSearch.h"
+#include "Solver.h"
+#include "TestException.h"
+
+#include <algorithm>
+#include <exception>
+#include <vector>
+
+typedef WW::state_t state_t;
+
+namespace {
+
+    /** The plan one strategy of the portfolio found, or why it found none */
+    struct StrategyPlan
+    {
+        StrategyPlan() : plan(), cost(0), found(false), error() {}
+        WW::StepList plan;
+        int cost;
+        bool found;
+        std::exception_ptr error; // set if the strategy threw
+    };
+
+    /** Beam width of the portfolio when no wider one is asked for */
+    const size_t PORTFOLIO_BEAM_WIDTH = 4;
+    /** Required steps the portfolio orders exactly at most when no other
+     * limit is asked for
+     */
+    const size_t PORTFOLIO_EXACT_LIMIT = 16;
+}
+
+int
+WW::solvePortfolio(const state_t& state, const WW::StepList& pending, WW::SolverThreads& threads, const WW::OrderOptions& options, WW::StepList& out_result, WW::OrderStats& out_stats, WW::Progress& progress)
+{
+    const WW::Deadline deadline(options.searchTime);
+    std::vector<StrategyPlan> plans(WW::STRATEGY_COUNT);
+    std::vector<char> cutShort(WW::STRATEGY_COUNT, 0); // rather than bool, so the tasks can each set theirs at once
+    WW::OrderStats search;
+    WW::OrderStats exact;
+    WW::Progress quiet(pending.size(), false); // only insertion reports its progress
+    threads.pool().run(3, [&](size_t task, unsigned int worker) {
+        WW::ScopedSearch scope(threads.context(worker), 0);
+        WW::SolveContext& context = threads.context(worker);
+        WW::StepList order;
+        if (task == 0) {
+            StrategyPlan& insertion = plans[WW::INSERTION];
+            bool placed = false;
+            try {
+                placed = WW::orderByInsertion(state, pending, threads, deadline, order, progress);
+                cutShort[WW::INSERTION] = !placed;
+                insertion.found = WW::planFor(state, order, context, insertion.plan, insertion.cost, placed);
+            }
+            catch (const WW::TestException&) {
+                insertion.found = false;
+                insertion.error = std::current_exception();
+            }
+            if (insertion.found) {
+                StrategyPlan& improved = plans[WW::LOCAL_SEARCH];
+                search.before = insertion.cost;
+                search.after = insertion.cost;
+                try {
+                    cutShort[WW::LOCAL_SEARCH] = !WW::improveOrder(state, order, threads, options, deadline, search);
+                    improved.found = WW::planFor(state, order, context, improved.plan, improved.cost, placed); // whatever insertion put at the end is still poorly ordered
+                    if (improved.found && improved.cost < insertion.cost) {
+                        search.after = improved.cost;
+                    }
+                }
+                catch (const WW::TestException&) {
+                    improved.found = false;
+                    improved.error = std::current_exception();
+                }
+            }
+        }
+        else if (task == 1) {
+            StrategyPlan& beam = plans[WW::BEAM];
+            try {
+                WW::StepList greedy;
+                cutShort[WW::BEAM] = !WW::orderByBeam(state, pending, threads, std::max(options.beamWidth, PORTFOLIO_BEAM_WIDTH), deadline, order, greedy, quiet);
+                beam.found = WW::planFor(state, order, context, beam.plan, beam.cost, !cutShort[WW::BEAM]);
+            }
+            catch (const WW::TestException&) {
+                beam.found = false;
+                beam.error = std::current_exception();
+            }
+        }
+        else {
+            StrategyPlan& exactly = plans[WW::EXACT];
+            const size_t limit = (options.exactLimit > 0) ? options.exactLimit : PORTFOLIO_EXACT_LIMIT;
+            try {
+                exactly.found = WW::solveExactly(state, pending, threads, limit, deadline, order, exactly.plan, exactly.cost, exact);
+            }
+            catch (const WW::TestException&) {
+                exactly.found = false;
+                exactly.error = std::current_exception();
+            }
+        }
+    });
+
+    size_t winner = WW::STRATEGY_COUNT;
+    for (size_t strategy = 0; strategy < WW::STRATEGY_COUNT; ++strategy) {
+        if (plans[strategy].found && (winner == WW::STRATEGY_COUNT || plans[strategy].cost < plans[winner].cost)) {
+            winner = strategy;
+        }
+    }
+    out_stats.exactTried += exact.exactTried;
+    out_stats.exact += exact.exact;
+    out_stats.before += search.before;
+    out_stats.after += search.after;
+    out_stats.tried += search.tried;
+    out_stats.taken += search.taken;
+    out_stats.cutShort += exact.cutShort + std::count(cutShort.begin(), cutShort.end(), 1);
+    if (winner == WW::STRATEGY_COUNT) {
+        for (size_t strategy = 0; strategy < WW::STRATEGY_COUNT; ++strategy) {
+            if (plans[strategy].error) {
+                std::rethrow_exception(plans[strategy].error); // as the strategy would have alone
+            }
+        }
+        // as solveForSequence(), failure costs nothing and gives part of a plan
+        out_result.splice(out_result.end(), plans[WW::INSERTION].plan);
+        return 0;
+    }
+    ++out_stats.wins[winner];
+    out_result.splice(out_result.end(), plans[winner].plan);
+    return plans[winner].cost;
+}
@@ -0,0 +1,45 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_PORTFOLIO_HEADER
+#define INCLUDE_WW_PORTFOLIO_HEADER
+
+#include "CompiledSteps.h"
+#include "Ordering.h"
+#include "StepList.h"
+
+namespace WW
+{
+    class Progress;
+    class SolverThreads;
+
+    /** Order the `pending` steps by each strategy at once, each on a thread
+     * of its own, and take the cheapest plan any of them finds.  The
+     * strategies share nothing but the compiled steps, which are only read.
+     * Local search starts from the order insertion finds, so follows it on
+     * the same thread.
+     *
+     * Every strategy stops once `options.searchTime` has passed since the
+     * portfolio started, as checked between the steps of its search rather
+     * than within a solve, with the best order it has by then, whose plan is
+     * then worked out; exact ordering has none, so offers no plan.  An order
+     * stopped before every step was placed ends with the rest in turn, and
+     * is planned without looking ahead, since looking ahead along so poor an
+     * order can take far longer than the budget.
+     *
+     * A strategy which throws, as insertion does when it can not walk the
+     * order it has, offers no plan, and the cheapest of the others is
+     * taken.  Only if none finds a plan is the first error thrown on.
+     *
+     * Of equally cheap plans, the one found by the strategy first in
+     * `Strategy` is taken, so which is taken does not depend on which
+     * finishes first.  The plan taken is the same from one run to the next
+     * only if no strategy is stopped by the deadline, since how far each
+     * gets by then depends on the machine and how busy it is.
+     */
+    int solvePortfolio(const state_t& state, const StepList& pending, SolverThreads& threads, const OrderOptions& options, StepList& out_result, OrderStats& out_stats, Progress& progress);
+}
+
+#endif // INCLUDE_WW_PORTFOLIO_HEADER
@@ -0,0 +1,125 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "Reachability.h"
+
+#include <algorithm>
+
+WW::Reachability::Reachability()
+: m_values()
+, m_absent()
+, m_runnable()
+{
+}
+
+WW::Reachability::Reachability(const ids_t& start, const std::vector<operation_t>& operations)
+: m_values()
+, m_absent()
+, m_runnable()
+{
+    assign(start, operations);
+}
+
+void
+WW::Reachability::assign(const ids_t& start, const std::vector<operation_t>& operations)
+{
+    m_values.clear();
+    m_absent.clear();
+    m_runnable.assign(operations.size(), false);
+    for (ids_t::const_iterator it = start.begin(); it != start.end(); ++it) {
+        add(*it);
+        m_absent[it->key()] = false;
+    }
+
+    // Anything an operation makes hold only helps others run, so keep
+    // going until a pass over the operations finds nothing new to run.
+    bool grown = true;
+    while (grown) {
+        grown = false;
+        for (size_t i = 0; i < operations.size(); ++i) {
+            if (m_runnable[i]) {
+                continue;
+            }
+            const ids_t& dependencies = operations[i].dependencies();
+            bool runnable = true;
+            for (ids_t::const_iterator it = dependencies.begin(); runnable && it != dependencies.end(); ++it) {
+                runnable = canHold(*it);
+            }
+            if (!runnable) {
+                continue;
+            }
+            m_runnable[i] = grown = true;
+            const ids_t& changes = operations[i].changes();
+            for (ids_t::const_iterator it = changes.begin(); it != changes.end(); ++it) {
+                add(*it);
+            }
+        }
+    }
+}
+
+bool
+WW::Reachability::canHold(const AttributeId& attribute) const
+{
+    if (attribute.key() >= m_values.size()) {
+        // never present at the start nor given by any operation
+        return attribute.isForbidden();
+    }
+    const std::vector<id_t>& values = m_values[attribute.key()];
+    if (!attribute.isForbidden()) {
+        return std::find(values.begin(), values.end(), attribute.compoundValue()) != values.end();
+    }
+    if (m_absent[attribute.key()]) {
+        return true;
+    }
+    for (std::vector<id_t>::const_iterator it = values.begin(); it != values.end(); ++it) {
+        if (*it != attribute.compoundValue()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t
+WW::Reachability::runnableCount() const
+{
+    return std::count(m_runnable.begin(), m_runnable.end(), true);
+}
+
+void
+WW::Reachability::findUnreachable(const ids_t& dependencies, ids_t& out_result) const
+{
+    out_result.clear();
+    for (ids_t::const_iterator it = dependencies.begin(); it != dependencies.end(); ++it) {
+        if (!canHold(*it)) {
+            out_result.insert(*it);
+        }
+    }
+}
+
+/** Note that `attribute` can hold; an attribute which is forbidden is the
+ * absence of its key.
+ */
+void
+WW::Reachability::add(const AttributeId& attribute)
+{
+    grow(attribute.key());
+    if (attribute.isForbidden()) {
+        m_absent[attribute.key()] = true;
+        return;
+    }
+    std::vector<id_t>& values = m_values[attribute.key()];
+    if (std::find(values.begin(), values.end(), attribute.compoundValue()) == values.end()) {
+        values.push_back(attribute.compoundValue());
+    }
+}
+
+void
+WW::Reachability::grow(id_t key)
+{
+    if (key >= m_values.size()) {
+        m_values.resize(key + 1);
+        m_absent.resize(key + 1, true); // until present at the start
+    }
+}
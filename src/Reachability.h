@@ -0,0 +1,62 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_REACHABILITY_HEADER
+#define INCLUDE_WW_REACHABILITY_HEADER
+
+#include "AttributeTable.h"
+
+#include <vector>
+
+namespace WW
+{
+    /** Which attributes could ever hold, and which operations could ever
+     * run, starting from a given state.
+     *
+     * This is worked out for the relaxation in which running an operation
+     * never stops anything else holding: every value a key has been given,
+     * and its absence once it has been removed, are taken to hold together.
+     * So whatever can hold in reality can hold in the relaxation, and
+     * anything which can not hold even there can never hold at all.
+     */
+    class Reachability
+    {
+    public:
+        typedef AttributeTable::ids_t ids_t;
+        typedef AttributeTable::id_operation_t operation_t;
+        typedef AttributeId::id_t id_t;
+
+    public:
+        ~Reachability() {}
+        Reachability();
+        Reachability(const ids_t& start, const std::vector<operation_t>& operations);
+
+    private: // forbid copy and assignment
+        Reachability(const Reachability& copy);
+        Reachability& operator=(const Reachability& copy);
+
+    public:
+        void assign(const ids_t& start, const std::vector<operation_t>& operations);
+
+        /** Whether `attribute`, which may be forbidden, could ever hold */
+        bool canHold(const AttributeId& attribute) const;
+        /** Whether the operation at `index` could ever run */
+        bool canRun(size_t index) const { return m_runnable[index]; }
+        size_t runnableCount() const;
+        /** Those of `dependencies` which can never hold */
+        void findUnreachable(const ids_t& dependencies, ids_t& out_result) const;
+
+    private:
+        void add(const AttributeId& attribute);
+        void grow(id_t key);
+
+    private:
+        std::vector<std::vector<id_t> > m_values; // by key, every value it could have
+        std::vector<bool> m_absent; // by key, whether it could be absent
+        std::vector<bool> m_runnable; // by operation
+    };
+}
+
+#endif // INCLUDE_WW_REACHABILITY_HEADER
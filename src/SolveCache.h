@@ -0,0 +1,141 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_SOLVECACHE_HEADER
+#define INCLUDE_WW_SOLVECACHE_HEADER
+
+#include "StepList.h"
+
+#include <unordered_map>
+
+namespace WW
+{
+    /** Memory held by a set of attributes beyond the set itself, for the
+     * estimates of a SolveCache keyed by it; overloaded for other keys.
+     */
+    template <class _Attributes>
+        size_t
+        heapSize(const _Attributes& attributes)
+        {
+            return attributes.size() * (4 * sizeof(void*) + sizeof(typename _Attributes::value_type));
+        }
+
+    /** Memoizes the results of solving from one state to a target.
+     *
+     * A cache is only valid while the set of steps it refers to is unchanged,
+     * so it is expected to live for a single Steps::calculate().  The memory
+     * used is estimated as entries are added; once the estimate exceeds the
+     * limit the cache is emptied and starts again.
+     *
+     * Results are kept as a StepList unless another type, such as a Plan, is
+     * given; it must be copyable and provide `size()`.
+     */
+    template <class _Attributes, class _Result = StepList>
+        class SolveCache
+        {
+        public:
+            typedef _Attributes attributes_t;
+            typedef _Result result_t;
+
+            struct Stats
+            {
+                Stats() : hits(0), misses(0), evictions(0) {}
+                unsigned long hits;
+                unsigned long misses;
+                unsigned long evictions;
+            };
+
+            static const size_t DEFAULT_MEMORY_LIMIT = 64 * 1024 * 1024;
+
+        public:
+            ~SolveCache() {}
+            explicit SolveCache(size_t memoryLimit = DEFAULT_MEMORY_LIMIT)
+                : m_entries()
+                , m_memoryUsed(0)
+                , m_memoryLimit(memoryLimit)
+                , m_stats()
+                {}
+
+        private: // forbid copy and assignment
+            SolveCache(const SolveCache& copy);
+            SolveCache& operator=(const SolveCache& copy);
+
+        public:
+            bool find(const attributes_t& state, const attributes_t& target, int& out_cost, result_t& out_result) {
+                typename map_t::const_iterator it = m_entries.find(Key(state, target));
+                if (it == m_entries.end()) {
+                    ++m_stats.misses;
+                    return false;
+                }
+                ++m_stats.hits;
+                out_cost = it->second.cost;
+                out_result = it->second.result;
+                return true;
+            }
+
+            void insert(const attributes_t& state, const attributes_t& target, int cost, const result_t& result) {
+                Key key(state, target);
+                Entry entry(cost, result);
+                size_t size = estimateSize(key, entry);
+                if (size > m_memoryLimit) {
+                    return; // would never fit
+                }
+                if (m_memoryUsed + size > m_memoryLimit) {
+                    ++m_stats.evictions;
+                    clear();
+                }
+                if (m_entries.insert(typename map_t::value_type(key, entry)).second) {
+                    m_memoryUsed += size;
+                }
+            }
+
+            void clear() { m_entries.clear(); m_memoryUsed = 0; }
+
+            size_t size() const { return m_entries.size(); }
+            size_t memoryUsed() const { return m_memoryUsed; }
+            size_t memoryLimit() const { return m_memoryLimit; }
+            const Stats& stats() const { return m_stats; }
+
+        private:
+            struct Key
+            {
+                Key(const attributes_t& state, const attributes_t& target) : state(state), target(target), hash(state.hash() * 31 + target.hash()) {}
+                attributes_t state;
+                attributes_t target;
+                size_t hash;
+                bool operator==(const Key& rhs) const { return hash == rhs.hash && state == rhs.state && target == rhs.target; }
+            };
+            struct KeyHash
+            {
+                size_t operator()(const Key& key) const { return key.hash; }
+            };
+            struct Entry
+            {
+                Entry(int cost, const result_t& result) : cost(cost), result(result) {}
+                int cost;
+                result_t result;
+            };
+            typedef std::unordered_map<Key, Entry, KeyHash> map_t;
+
+            /** Approximate heap footprint of an entry; each container node
+             * carries roughly four pointers of overhead plus its element.
+             */
+            static size_t estimateSize(const Key& key, const Entry& entry) {
+                const size_t node = 4 * sizeof(void*);
+                size_t result = sizeof(typename map_t::value_type) + node;
+                result += heapSize(key.state) + heapSize(key.target);
+                result += entry.result.size() * (node + sizeof(void*));
+                return result;
+            }
+
+        private:
+            map_t m_entries;
+            size_t m_memoryUsed;
+            size_t m_memoryLimit;
+            Stats m_stats;
+        };
+}
+
+#endif // INCLUDE_WW_SOLVECACHE_HEADER
@@ -0,0 +1,920 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "Solver.h"
+
+#include "Hubs.h"
+#include "Macros.h"
+#include "TestException.h"
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+
+#define DEBUG
+#define DBGOUT(_x) do { std::cerr << "DEBUG: " << _x << std::endl; } while (0)
+
+typedef WW::state_t state_t;
+
+namespace {
+
+    /** Indices, in store order, of the steps whose changes provide any of
+     * `attributes`, leaving out those which can never run, and, if there is
+     * no chain to guide the choice, those duplicated by a better step.
+     *
+     * Macro steps are only a shortcut for a solve without a chain, so are
+     * left out unless that is what this is and they can run at once in the
+     * state given by `present`.  They come first, so their cost bounds the
+     * search of the others, but lose a tie with any of them.
+     */
+    void findStepsProviding(const WW::SolveContext& context, const state_t& attributes, bool chainless, const WW::StepTable::mask_t& present, WW::StepTable::indices_t& out_result)
+    {
+        context.stepTable.findProviding(attributes, out_result);
+        const WW::CompiledSteps& compiled = context.compiled;
+        out_result.erase(std::remove_if(out_result.begin(), out_result.end(), [&compiled, chainless, &present](size_t index) {
+            if (compiled.isMacro(index)) {
+                return !chainless || !compiled.stepTable.isValid(index, present);
+            }
+            return !compiled.reachable.canRun(index) || (chainless && compiled.dominance[index] == WW::DUPLICATED);
+        }), out_result.end());
+        // macro steps come after the others in store order, so bringing them to the front keeps both in order
+        std::rotate(out_result.begin(), std::find_if(out_result.begin(), out_result.end(), [&compiled](size_t index) { return compiled.isMacro(index); }), out_result.end());
+    }
+
+    /** Throw unless `step` can run in `state` */
+    void
+        checkStep(const state_t& state, const WW::TestStep& step, const WW::SolveContext& context)
+        {
+            if (!context.operation(step).isValid(state))
+            {
+                std::ostringstream ost;
+
+                state_t cr;
+
+                state_t::find_changes(state, context.operation(step).dependencies(), cr);
+
+                ost << "ERROR: unexpectedly unable to apply solved state " << step << " " << step.operation() << " onto " << context.attributes.names(state) << ".  Missing " << context.attributes.names(cr);
+                throw WW::TestException(ost.str().c_str());
+            }
+        }
+
+    void
+        applyStep(state_t& state, const WW::TestStep& step, const WW::SolveContext& context)
+        {
+#ifdef DEBUG
+            checkStep(state, step, context);
+#endif
+            context.operation(step).modify(state);
+        }
+
+    /** The dependencies of step `index`, by the context's state table */
+    const WW::StateId&
+        dependencies(size_t index, WW::SolveContext& context)
+        {
+            WW::StateId& result = context.dependencies[index];
+            if (!result.valid()) {
+                result = context.states.intern(context.operations[index].dependencies());
+            }
+            return result;
+        }
+
+    /** Put a solution in the memo, with a copy of its plan made by the
+     * memo's arena, and count it towards its promotion to a macro step.
+     */
+    void
+        memoizePlan(const WW::StateId& state, const WW::StateId& target, int cost, const WW::Plan& solution, WW::SolveContext& context)
+        {
+            context.buffer.clear();
+            solution.appendTo(context.buffer);
+            context.cache.insert(state, target, cost, context.memoPlans.copy(context.buffer));
+            WW::recordSequence(solution, context);
+        }
+
+    /** Empty the memo, and reclaim its plans, once they occupy as much as
+     * the memo may; but only while no solve in progress could be using them.
+     * The same goes for the state table, and with it everything keyed by
+     * its ids.
+     */
+    void
+        recycleMemo(WW::SolveContext& context)
+        {
+            if (!context.frames.empty()) {
+                return;
+            }
+            const bool states = context.states.memoryUsed() > context.cache.memoryLimit();
+            if (states || context.memoPlans.memoryUsed() > context.cache.memoryLimit()) {
+                context.cache.clear();
+                context.memoPlans.reset();
+            }
+            if (states) {
+                context.searchCache.clear();
+                context.states.clear();
+                std::fill(context.dependencies.begin(), context.dependencies.end(), WW::StateId());
+            }
+        }
+
+    /** Throw if the last solve, of the dependencies of `step`, was cut
+     * short by the depth limit, so is no answer at all
+     */
+    void
+        checkDepthLimit(const WW::TestStep& step, const WW::SolveContext& context)
+        {
+            if (context.truncated) {
+                std::ostringstream ost;
+                ost << "Unable to solve the dependencies of " << step.short_desc() << " within the depth limit of " << context.threads.depthLimit();
+                throw WW::TestException(ost.str().c_str());
+            }
+        }
+
+    /** Solve the dependencies of `step`, throwing if there is no solution */
+    int
+        solveOrThrow(const state_t& state, const WW::TestStep& step, WW::SolveContext& context, WW::StepList& out_result)
+        {
+            const state_t& target = context.operation(step).dependencies();
+            int cost = WW::solve(state, target, context, out_result);
+            checkDepthLimit(step, context);
+            if (cost > 0 && out_result.empty()) {
+                state_t cr;
+
+                state_t::find_changes(state, target, cr);
+
+                std::ostringstream ost;
+                ost << "No solution, need these dependencies defined: " << context.attributes.names(cr) << " to get from " << context.attributes.names(state) << " to " << context.attributes.names(target);
+                throw WW::TestException(ost.str().c_str());
+            }
+            return cost;
+        }
+
+    /** Solves nested more deeply than this explore their candidates sequentially */
+    const unsigned int FORK_DEPTH = 4;
+
+    /** Whether the candidates of a solve are worth exploring in parallel */
+    bool
+        shouldFork(const WW::StepTable::indices_t& candidates, const WW::StepTable::mask_t& present, const WW::SolveContext& context)
+        {
+            if (context.depth > FORK_DEPTH || context.threads.pool().size() < 2) {
+                return false;
+            }
+            size_t searches = 0;
+            for (WW::StepTable::indices_t::const_iterator it = candidates.begin(); it != candidates.end(); ++it) {
+                if (!context.stepTable.isValid(*it, present) && ++searches > 1) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    /** Solve the dependencies of each candidate which is not immediately
+     * valid as a separate task, for solve() to choose between.
+     *
+     * The cheapest outcome found so far is shared between the tasks; a
+     * candidate which cannot be cheaper than it, nor than `bound`, is
+     * abandoned.  Ties are left for solve() to settle in candidate order.
+     */
+    void
+        forkCandidates(const state_t& state, const WW::StepTable::indices_t& candidates, const WW::StepTable::mask_t& present, int bound, WW::SolveContext& context, std::vector<WW::CandidateOutcome>& out_outcomes)
+        {
+            out_outcomes.clear();
+            out_outcomes.resize(candidates.size());
+            std::atomic<int> best(std::numeric_limits<int>::max());
+            for (WW::StepTable::indices_t::const_iterator it = candidates.begin(); it != candidates.end(); ++it) {
+                int cost = context.steps[*it]->cost();
+                if (cost < best && context.stepTable.isValid(*it, present)) {
+                    best = cost;
+                }
+            }
+
+            WW::SolverThreads& threads = context.threads;
+            const WW::CompiledSteps& compiled = context.compiled;
+            unsigned int depth = context.depth;
+            WW::ThreadPool::TaskGroup group(threads.pool());
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                if (context.stepTable.isValid(candidates[i], present)) {
+                    continue;
+                }
+                group.fork([&, i](unsigned int worker) {
+                    const WW::TestStep& candidate = *compiled.steps[candidates[i]];
+                    WW::CandidateOutcome& result = out_outcomes[i];
+                    WW::SolveContext& local = threads.context(worker);
+                    int cheapest = best;
+                    int limit = (cheapest == std::numeric_limits<int>::max()) ? bound : std::min(bound, cheapest + 1);
+                    if (compiled.nonNegativeCosts && static_cast<int>(candidate.cost()) >= limit) {
+                        ++local.pruned;
+                        result.pruned = true;
+                        return;
+                    }
+                    WW::ScopedSearch scope(local, depth);
+                    int dependencies = WW::solve(state, compiled.operations[candidates[i]].dependencies(), local, result.list, compiled.nonNegativeCosts ? limit - candidate.cost() : WW::UNBOUNDED);
+                    result.truncated = local.truncated;
+                    if (dependencies == WW::BOUND_EXCEEDED) {
+                        ++local.pruned;
+                        result.pruned = true;
+                        return;
+                    }
+                    result.outcome = candidate.cost() + dependencies;
+                    if (result.outcome > 0 && result.list.empty()) {
+                        return;
+                    }
+                    int current = best;
+                    while (result.outcome < current && !best.compare_exchange_weak(current, result.outcome)) {
+                    }
+                });
+            }
+            group.wait();
+        }
+
+    /** Start a solve on the frame stack for `parent`, or for the caller if
+     * there is none.  The solve fails instead if it would be nested more
+     * deeply than the depth limit, or if it is already in progress in the
+     * same search, so is needed by itself; any solution through it would
+     * only be dearer than one found without it.  Either way `parent` is
+     * marked as depending on an outcome which is not final.
+     *
+     * A solve without a chain for which the hub table has a plan cheaper
+     * than `bound` is bounded by that plan instead, and falls back on it if
+     * it finds nothing cheaper.
+     */
+    bool
+        pushFrame(const WW::StateId& state, const WW::StateId& target, WW::SolveContext& context, WW::StepList::const_iterator chainStart, WW::StepList::const_iterator chainEnd, int bound, bool memoize, WW::SolveFrame* parent)
+        {
+            if (context.depth >= context.threads.depthLimit()) {
+                ++context.depthExceeded;
+                if (parent != 0) {
+                    parent->truncated = true;
+                }
+                return false;
+            }
+            WW::SolveFrame& frame = context.frames.push();
+            frame.state = state;
+            frame.target = target;
+            frame.chainStart = chainStart;
+            frame.chainEnd = chainEnd;
+            frame.bound = bound;
+            frame.memoize = memoize;
+            if (memoize && context.threads.hubs() != 0) {
+                const WW::HubPlan* hub = context.threads.hubs()->find(context.states.attributes(state), context.states.attributes(target));
+                if (hub != 0 && hub->cost < bound) {
+                    frame.hub = hub;
+                    frame.bound = hub->cost + 1; // an outcome as cheap as the plan is still preferred
+                }
+            }
+            frame.level = context.frames.size() - 1;
+            frame.hash = state.hash() * 31 + target.hash();
+
+            std::pair<WW::in_progress_t::iterator, bool> inserted = context.inProgress.insert(&frame);
+            if (!inserted.second) {
+                WW::SolveFrame& other = **inserted.first;
+                if (other.level >= context.searchBase) {
+                    ++context.cyclesCut;
+                    if (parent != 0) {
+                        parent->cycleLevel = std::min(parent->cycleLevel, other.level);
+                    }
+                    context.frames.pop();
+                    return false;
+                }
+                frame.shadows = &other;
+                context.inProgress.erase(inserted.first);
+                context.inProgress.insert(&frame);
+            }
+            ++context.depth;
+            return true;
+        }
+
+    /** Finish with the solve on top of the frame stack */
+    void
+        popFrame(WW::SolveContext& context)
+        {
+            WW::SolveFrame& frame = context.frames.top();
+            context.inProgress.erase(&frame);
+            if (frame.shadows != 0) {
+                context.inProgress.insert(frame.shadows);
+            }
+            context.frames.pop();
+            --context.depth;
+        }
+
+    /** Solve without a frame, from the memo or by the A* engine's search.
+     * Returns false if the recursive solver is needed.
+     *
+     * The A* engine searches the state space, falling back to the recursive
+     * solver if the search grows too large, or if any step has a negative
+     * cost and so could make the search's estimates overstate.
+     */
+    bool
+        solveMemoized(const WW::StateId& state, const WW::StateId& target, WW::SolveContext& context, WW::Plan& out_result, int bound, int& out_cost)
+        {
+            if (context.cache.find(state, target, out_cost, out_result)) {
+                return true;
+            }
+            if (context.threads.engine() == WW::Steps::ASTAR && context.compiled.nonNegativeCosts) {
+                if (WW::searchStates(context.states.attributes(state), context.states.attributes(target), context, context.buffer, bound, out_cost)) {
+                    if (out_cost != WW::BOUND_EXCEEDED) {
+                        out_result = context.memoPlans.copy(context.buffer);
+                        context.cache.insert(state, target, out_cost, out_result);
+                        WW::recordSequence(out_result, context);
+                    }
+                    else {
+                        out_result = context.plans.copy(context.buffer);
+                    }
+                    return true;
+                }
+                ++context.searchesAbandoned;
+            }
+            return false;
+        }
+
+    /** Solve `target` from `state` on behalf of `frame`, leaving the outcome
+     * in its childCost and childList.  Returns false if a frame had to be
+     * pushed for it, in which case the outcome is there once that frame
+     * completes.
+     */
+    bool
+        beginSolve(WW::SolveFrame& frame, const WW::StateId& state, const WW::StateId& target, WW::SolveContext& context, WW::StepList::const_iterator chainStart, WW::StepList::const_iterator chainEnd, int bound)
+        {
+            frame.childList.clear();
+            // The chain only guides the recursive engine's choice between candidates
+            const bool memoize = (chainStart == chainEnd || context.threads.engine() == WW::Steps::ASTAR);
+            if (memoize) {
+                if (solveMemoized(state, target, context, frame.childList, bound, frame.childCost)) {
+                    return true;
+                }
+                chainStart = chainEnd = context.noChain.end();
+            }
+            if (pushFrame(state, target, context, chainStart, chainEnd, bound, memoize, &frame)) {
+                return false;
+            }
+            frame.childCost = 1;
+            return true;
+        }
+
+    /** Add a solution using candidate step `index` to those of `frame`,
+     * having found `outcome` to be its cost, and keep it if it is the
+     * cheapest so far.
+     */
+    void
+        considerCandidate(WW::SolveFrame& frame, size_t index, int outcome, WW::SolveContext& context)
+        {
+            const WW::TestStep& candidate = *context.steps[index];
+            frame.list = context.plans.join(frame.list, context.plans.step(candidate));
+            if (frame.chainStart != frame.chainEnd) {
+                // This isn't working because we are calculating the *dependencies* - we don't know the item to solve.  Can't do this here.
+                frame.candidateState = WW::applyState(frame.state, frame.list, context);
+                const state_t& copy = context.states.attributes(frame.candidateState);
+                if (context.operation(*frame.chainStart).isValid(copy)) {
+                    // DBGOUT("  Solving remaining chain - cost=" << frame.cost << ": " << frame.list);
+                    WW::ScratchList tmp(context);
+                    frame.cost += WW::solveForSequence(copy, frame.chainStart, frame.chainEnd, context, tmp.list(), true);
+                    // We want to see whether the solution satisfies target.
+                    // If it does, and if we have access to a list of remaining
+                    // elements, then we want to solve that list, to see
+                    // whether we can introduce a rule which will make that
+                    // subsequent chain even cheaper.  That remaining chain
+                    // need not be a full list; it could be just a fixed count,
+                    // an optimisation which ought to reduce the performance
+                    // overhead.
+
+                    // This function will all solveForSequence(), while that function
+                    // is still expected to call this one.  We need to limit
+                    // when this recursion happens, since in some cases we do
+                    // want it and in others it just isn't useful - or may even
+                    // be harmful.
+                    //
+                }
+            }
+
+            if (frame.result.empty() || outcome < frame.cost || (outcome == frame.cost && frame.macroChosen))
+            {
+                frame.solved = true;
+                frame.macroChosen = context.compiled.isMacro(index);
+                frame.cost = outcome;
+                frame.result = frame.list;
+            }
+        }
+
+    /** Continue the solve on top of the frame stack until either it is
+     * complete, with its outcome in `cost` and `result`, or it has pushed a
+     * frame for a solve it needs first.  Returns whether it is complete.
+     *
+     * Determine the cheapest set of steps to iterate from `state` to
+     * `target`: the cheapest of the steps providing some attribute still
+     * needed, with whatever its dependencies need, followed by whatever is
+     * still needed after that.
+     *
+     * Without a chain, candidates are compared only by their own outcome, so
+     * a candidate which cannot beat the best found so far, or the bound, is
+     * abandoned.  Every solution includes one of the candidates and no step
+     * costs less than nothing, so a candidate's own cost is a lower bound on
+     * its outcome.  When that reaches the limit it is not explored at all;
+     * otherwise the limit less its cost bounds the solve of its dependencies.
+     * The solution chosen is the same as without bounds, unless it would
+     * cost at least `bound`, in which case BOUND_EXCEEDED is returned.
+     */
+    bool
+        advance(WW::SolveFrame& frame, WW::SolveContext& context)
+        {
+            switch (frame.phase) {
+            case WW::SolveFrame::START:
+                // DBGOUT("solve(state=" << frame.state << ", target=" << frame.target << ", steps, out_result, chainStart, chainEnd) " << WW::StepList(frame.chainStart, frame.chainEnd));
+                state_t::find_changes(context.states.attributes(frame.state), context.states.attributes(frame.target), frame.changes);
+                if (frame.changes.size() == 0)
+                {
+                    frame.cost = 0;
+                    return true;
+                }
+                context.stepTable.stateMask(context.states.attributes(frame.state), frame.present);
+                findStepsProviding(context, frame.changes, frame.chainStart == frame.chainEnd, frame.present, frame.candidates);
+                if (frame.candidates.size() == 0)
+                {
+                    // This one is unusable; no step provides the attributes
+                    frame.cost = 99999;
+                    return true;
+                }
+
+                frame.bounded = (frame.chainStart == frame.chainEnd) && context.compiled.nonNegativeCosts;
+                if (!frame.bounded) {
+                    frame.bound = WW::UNBOUNDED;
+                }
+                // A candidate costing more than one which is immediately valid
+                // can never be chosen, wherever it comes in the order.
+                frame.immediate = WW::UNBOUNDED;
+                if (frame.bounded) {
+                    for (WW::StepTable::indices_t::const_iterator it = frame.candidates.begin(); it != frame.candidates.end(); ++it) {
+                        int cost = context.steps[*it]->cost();
+                        if (cost < frame.immediate && context.stepTable.isValid(*it, frame.present)) {
+                            frame.immediate = cost;
+                        }
+                    }
+                }
+
+                if (frame.chainStart == frame.chainEnd && shouldFork(frame.candidates, frame.present, context)) {
+                    forkCandidates(context.states.attributes(frame.state), frame.candidates, frame.present, frame.bound, context, frame.forked);
+                }
+                frame.phase = WW::SolveFrame::CANDIDATES;
+                // fall through
+
+            case WW::SolveFrame::CANDIDATES:
+                for (; frame.next < frame.candidates.size(); ++frame.next)
+                {
+                    const size_t index = frame.candidates[frame.next];
+                    const WW::TestStep& candidate = *context.steps[index];
+                    if (!frame.awaiting) {
+                        frame.list.clear();
+                        if (context.stepTable.isValid(index, frame.present)) {
+                            // we don't need to search, it is immediately valid
+                            considerCandidate(frame, index, candidate.cost(), context);
+                            continue;
+                        }
+                        if (!frame.forked.empty()) {
+                            WW::CandidateOutcome& result = frame.forked[frame.next];
+                            frame.truncated = frame.truncated || result.truncated;
+                            if (result.pruned) {
+                                frame.abandoned = true;
+                            }
+                            else if (result.outcome == 0 || !result.list.empty()) {
+                                frame.list = context.plans.copy(result.list);
+                                considerCandidate(frame, index, result.outcome, context);
+                            }
+                            continue;
+                        }
+                        int bound = WW::UNBOUNDED;
+                        if (frame.bounded) {
+                            int limit = std::min(frame.bound, (frame.immediate == WW::UNBOUNDED) ? WW::UNBOUNDED : frame.immediate + 1);
+                            if (frame.solved) {
+                                // an equal outcome would lose to the earlier candidate, unless that is a macro step
+                                limit = std::min(limit, frame.macroChosen ? frame.cost + 1 : frame.cost);
+                            }
+                            if (static_cast<int>(candidate.cost()) >= limit) {
+                                ++context.pruned;
+                                frame.abandoned = true;
+                                continue;
+                            }
+                            bound = limit - candidate.cost();
+                        }
+                        frame.awaiting = true;
+                        if (!beginSolve(frame, frame.state, dependencies(index, context), context, frame.chainStart, frame.chainEnd, bound)) {
+                            return false;
+                        }
+                    }
+                    frame.awaiting = false;
+                    if (frame.bounded && frame.childCost == WW::BOUND_EXCEEDED) {
+                        ++context.pruned;
+                        frame.abandoned = true;
+                        continue;
+                    }
+                    int outcome = candidate.cost() + frame.childCost;
+                    if (outcome > 0 && frame.childList.empty()) {
+                        continue; // No solution was found
+                    }
+                    frame.list = frame.childList;
+                    considerCandidate(frame, index, outcome, context);
+                }
+
+                if (!frame.solved) {
+                    frame.cost = frame.abandoned ? WW::BOUND_EXCEEDED : 1;
+                    return true;
+                }
+                if (frame.cost >= frame.bound) {
+                    // What remains costs nothing less than nothing
+                    frame.result.clear();
+                    frame.cost = WW::BOUND_EXCEEDED;
+                    return true;
+                }
+
+                // The result is now a sequence starting from `state`, but may
+                // not get us all the way to `target`.  Solving the rest can't
+                // choose the same path, since those attributes are satisfied.
+                frame.candidateState = WW::applyState(frame.state, frame.result, context);
+                frame.phase = WW::SolveFrame::REMAINDER;
+                if (!beginSolve(frame, frame.candidateState, frame.target, context, context.noChain.end(), context.noChain.end(), (frame.bound == WW::UNBOUNDED) ? WW::UNBOUNDED : frame.bound - frame.cost)) {
+                    return false;
+                }
+                // fall through
+
+            case WW::SolveFrame::REMAINDER:
+                if (frame.childCost == WW::BOUND_EXCEEDED) {
+                    frame.result.clear();
+                    frame.cost = WW::BOUND_EXCEEDED;
+                }
+                else if (frame.childCost > 0 && frame.childList.empty()) {
+                    // This solution doesn't work.
+                    frame.result.clear();
+                    frame.cost = 1;
+                }
+                else {
+                    frame.cost += frame.childCost;
+                    frame.result = context.plans.join(frame.result, frame.childList);
+                }
+                // DBGOUT("  solved: " << frame.cost << ": " << frame.result);
+                return true;
+            }
+            return true;
+        }
+
+    /** Restores the frame stack and depth of a context once the solves run
+     * above them have completed, or been abandoned by an exception, and
+     * releases the partial plans they made.
+     */
+    class ScopedFrames
+    {
+    public:
+        explicit ScopedFrames(WW::SolveContext& context) : m_context(context), m_size(context.frames.size()), m_depth(context.depth), m_plans(context.plans.mark()) {}
+        ~ScopedFrames() {
+            while (m_context.frames.size() > m_size) {
+                popFrame(m_context);
+            }
+            m_context.depth = m_depth;
+            m_context.plans.release(m_plans);
+        }
+
+        size_t base() const { return m_size; }
+
+    private: // forbid copy and assignment
+        ScopedFrames(const ScopedFrames& copy);
+        ScopedFrames& operator=(const ScopedFrames& copy);
+
+    private:
+        WW::SolveContext& m_context;
+        size_t m_size;
+        unsigned int m_depth;
+        WW::PlanArena::Mark m_plans;
+    };
+
+    /** solve
+     * @params state        starting state
+     * @params target       set of desired attributes
+     * @params context      available steps and per-calculation solver state
+     * @params out_result   results to return
+     * @params chainStart   steps which are to follow, guiding the choice between candidates
+     * @params bound        the caller has no use for a solution costing this much or more
+     * @params memoize      whether solutions without a chain go in the memo
+
+     * Run a solve, and every solve it needs in turn, on the context's frame
+     * stack rather than the call stack, so the depth of nesting is limited
+     * only by the depth limit.  Solves may still be started by others in
+     * progress, to fork candidates or to try a chain, but these nest no more
+     * deeply than the fork depth or the chain's length.
+     *
+     * A solve nested beyond the depth limit fails, as if no step could
+     * help, and no solve depending on it is memoized.  So does a solve
+     * needed by itself, cutting the cycle; then the solves depending on it
+     * are not memoized until the one it needed is complete, as only from
+     * there do they have all the cycle's solutions to choose from.
+     */
+    int
+        runSolve(const WW::StateId& state, const WW::StateId& target, WW::SolveContext& context, WW::StepList& out_result, WW::StepList::const_iterator chainStart, WW::StepList::const_iterator chainEnd, int bound, bool memoize)
+        {
+            out_result.clear();
+            ScopedFrames scope(context);
+            if (!pushFrame(state, target, context, chainStart, chainEnd, bound, memoize, 0)) {
+                context.truncated = true;
+                return 1;
+            }
+            for (;;) {
+                WW::SolveFrame& frame = context.frames.top();
+                if (!advance(frame, context)) {
+                    continue;
+                }
+                if (frame.hub != 0 && (frame.cost == WW::BOUND_EXCEEDED || (frame.cost > 0 && frame.result.empty()))) {
+                    frame.cost = frame.hub->cost;
+                    frame.result = context.plans.copy(frame.hub->plan);
+                }
+                if (frame.memoize && !frame.truncated && frame.cycleLevel >= frame.level && frame.cost != WW::BOUND_EXCEEDED) {
+                    // A solve abandoned because of its bound is not a final answer
+                    memoizePlan(frame.state, frame.target, frame.cost, frame.result, context);
+                }
+                if (context.frames.size() == scope.base() + 1) {
+                    frame.result.appendTo(out_result);
+                    context.truncated = frame.truncated;
+                    return frame.cost;
+                }
+                WW::SolveFrame& parent = context.frames[context.frames.size() - 2];
+                parent.childCost = frame.cost;
+                parent.childList = frame.result;
+                parent.truncated = parent.truncated || frame.truncated;
+                parent.cycleLevel = std::min(parent.cycleLevel, frame.cycleLevel);
+                popFrame(context);
+            }
+        }
+}
+
+WW::SolveContext::SolveContext(const CompiledSteps& compiled, SolverThreads& threads)
+: compiled(compiled)
+, threads(threads)
+, attributes(compiled.attributes)
+, steps(compiled.steps)
+, operations(compiled.operations)
+, stepTable(compiled.stepTable)
+, plans()
+, memoPlans()
+, states()
+, dependencies(compiled.operations.size())
+, searched()
+, cache()
+, noChain()
+, depth(0)
+, pruned(0)
+, searchesAbandoned(0)
+, relevance()
+, searchCache()
+, frames()
+, inProgress()
+, searchBase(0)
+, cyclesCut(0)
+, depthExceeded(0)
+, truncated(false)
+, sequences()
+, buffer()
+, lists()
+{
+}
+
+WW::SolverThreads::SolverThreads(const CompiledSteps& compiled, const SolverArenas& arenas, WW::Steps::Engine engine, unsigned int depthLimit, bool learnMacros)
+: m_pool(arenas.threads(), [&arenas](unsigned int worker) { WW::Arena::setCurrent(arenas.arena(worker)); })
+, m_contexts()
+, m_engine(engine)
+, m_depthLimit(depthLimit)
+, m_learnMacros(learnMacros)
+, m_hubs(0)
+{
+    for (unsigned int worker = 0; worker < m_pool.size(); ++worker) {
+        m_contexts.push_back(std::unique_ptr<SolveContext>(new SolveContext(compiled, *this)));
+    }
+}
+
+WW::memo_t::Stats
+WW::SolverThreads::stats() const
+{
+    memo_t::Stats result;
+    for (std::vector<std::unique_ptr<SolveContext> >::const_iterator it = m_contexts.begin(); it != m_contexts.end(); ++it) {
+        const memo_t::Stats& stats = (*it)->cache.stats();
+        result.hits += stats.hits;
+        result.misses += stats.misses;
+        result.evictions += stats.evictions;
+    }
+    return result;
+}
+
+unsigned long
+WW::SolverThreads::pruned() const
+{
+    unsigned long result = 0;
+    for (std::vector<std::unique_ptr<SolveContext> >::const_iterator it = m_contexts.begin(); it != m_contexts.end(); ++it) {
+        result += (*it)->pruned;
+    }
+    return result;
+}
+
+unsigned long
+WW::SolverThreads::searchesAbandoned() const
+{
+    unsigned long result = 0;
+    for (std::vector<std::unique_ptr<SolveContext> >::const_iterator it = m_contexts.begin(); it != m_contexts.end(); ++it) {
+        result += (*it)->searchesAbandoned;
+    }
+    return result;
+}
+
+unsigned long
+WW::SolverThreads::depthExceeded() const
+{
+    unsigned long result = 0;
+    for (std::vector<std::unique_ptr<SolveContext> >::const_iterator it = m_contexts.begin(); it != m_contexts.end(); ++it) {
+        result += (*it)->depthExceeded;
+    }
+    return result;
+}
+
+unsigned long
+WW::SolverThreads::cyclesCut() const
+{
+    unsigned long result = 0;
+    for (std::vector<std::unique_ptr<SolveContext> >::const_iterator it = m_contexts.begin(); it != m_contexts.end(); ++it) {
+        result += (*it)->cyclesCut;
+    }
+    return result;
+}
+
+size_t
+WW::SolverThreads::deepestStack() const
+{
+    size_t result = 0;
+    for (std::vector<std::unique_ptr<SolveContext> >::const_iterator it = m_contexts.begin(); it != m_contexts.end(); ++it) {
+        result = std::max(result, (*it)->frames.allocated());
+    }
+    return result;
+}
+
+void
+WW::applyState(state_t& state, const WW::StepList& steps, const SolveContext& context)
+{
+    for (WW::StepList::const_iterator it = steps.begin(); it != steps.end(); ++it) {
+        applyStep(state, *it, context);
+    }
+}
+
+WW::StateId
+WW::applyState(const WW::StateId& state, const WW::Plan& steps, SolveContext& context)
+{
+    WW::StateId result = state;
+    steps.forEach([&result, &context](const WW::TestStep& step) {
+#ifdef DEBUG
+        checkStep(context.states.attributes(result), step, context);
+#endif
+        result = context.states.follow(result, context.operation(step).changes());
+    });
+    return result;
+}
+
+int
+WW::solve(const state_t& state, const state_t& target, SolveContext& context, WW::StepList& out_result, int bound)
+{
+    int cost = 0;
+    context.truncated = false;
+    recycleMemo(context);
+    const WW::StateId from = context.states.intern(state);
+    const WW::StateId to = context.states.intern(target);
+    WW::Plan plan;
+    if (solveMemoized(from, to, context, plan, bound, cost)) {
+        out_result.clear();
+        plan.appendTo(out_result);
+        return cost;
+    }
+    return runSolve(from, to, context, out_result, context.noChain.end(), context.noChain.end(), bound, true);
+}
+
+int
+WW::solve(const state_t& state, const state_t& target, SolveContext& context, WW::StepList& out_result, WW::StepList::const_iterator chainStart, WW::StepList::const_iterator chainEnd)
+{
+    if (chainStart == chainEnd || context.threads.engine() == WW::Steps::ASTAR) {
+        // The chain only guides the recursive engine's choice between candidates
+        return solve(state, target, context, out_result);
+    }
+    recycleMemo(context);
+    return runSolve(context.states.intern(state), context.states.intern(target), context, out_result, chainStart, chainEnd, UNBOUNDED, false);
+}
+
+int
+WW::solveForSequence(const state_t& startState, WW::StepList::const_iterator begin, WW::StepList::const_iterator end, SolveContext& context, WW::StepList& out_result, bool scanToEnd)
+{
+    // DBGOUT("solveForSequence(state=" << startState << ", begin=" << *begin << ", end, steps, out_result, scanToEnd=" << scanToEnd << ") " << WW::StepList(begin, end));
+    out_result.clear();
+    state_t state = startState;
+    int cost = 0;
+    WW::StepList::const_iterator scanEnd = begin;
+    for (size_t i = 1 ; (i < LOOK_AHEAD) && scanEnd != end ; ++i) {
+        ++scanEnd;
+    }
+    ScratchList scratch(context);
+    WW::StepList& solution = scratch.list();
+    for (WW::StepList::const_iterator it = begin; it != end; ++it) {
+        if (scanEnd != end) {
+            ++scanEnd;
+        }
+        int item_cost = solve(state, context.operation(*it).dependencies(), context, solution, (scanToEnd ? it : scanEnd), scanEnd);
+        if (context.depth == 0) {
+            // not trying a chain for a solve in progress, so this is the plan itself
+            checkDepthLimit(*it, context);
+        }
+        if (solution.size() > 0)
+        {
+            cost += item_cost;
+            applyState(state, solution, context);
+            append(out_result, solution);
+        }
+        else if (item_cost > 0) {
+            return 0; // empty solution means failure
+        }
+        cost += it->cost();
+        context.operation(*it).modify(state);
+        out_result.push_back(*it);
+    }
+    return cost;
+}
+
+void
+WW::walkSequence(const state_t& startState, const WW::StepList& sequence, SolveContext& context, SequenceWalk& out_walk)
+{
+    ScratchList scratch(context);
+    WW::StepList& solution = scratch.list();
+    state_t state = startState;
+    int cost = 0;
+    out_walk.states.clear();
+    out_walk.costs.clear();
+    out_walk.states.reserve(sequence.size() + 1);
+    out_walk.costs.reserve(sequence.size() + 1);
+    for (WW::StepList::const_iterator it = sequence.begin(); it != sequence.end(); ++it) {
+        out_walk.states.push_back(state);
+        out_walk.costs.push_back(cost);
+        cost += solveOrThrow(state, *it, context, solution) + it->cost();
+        applyState(state, solution, context);
+        context.operation(*it).modify(state);
+    }
+    out_walk.states.push_back(state);
+    out_walk.costs.push_back(cost);
+}
+
+int
+WW::solveSuffix(state_t& state, WW::StepList::const_iterator it, WW::StepList::const_iterator end, size_t position, const SequenceWalk& walk, SolveContext& context, bool& out_failed)
+{
+    ScratchList scratch(context);
+    WW::StepList& solution = scratch.list();
+    int cost = 0;
+    const size_t first = position;
+    out_failed = false;
+    for (; it != end; ++it, ++position) {
+        if (state == walk.states[position]) {
+            return cost + walk.costs.back() - walk.costs[position];
+        }
+        int item_cost = solve(state, context.operation(*it).dependencies(), context, solution);
+        if (solution.size() > 0)
+        {
+            cost += item_cost;
+            applyState(state, solution, context);
+        }
+        else if (item_cost > 0) {
+            out_failed = (position == first);
+            return 0; // as solveForSequence(), failure costs nothing
+        }
+        cost += it->cost();
+        context.operation(*it).modify(state);
+    }
+    return cost;
+}
+
+void
+WW::append(WW::StepList& dst, const WW::StepList& src)
+{
+    for (WW::StepList::const_iterator it = src.begin(); it != src.end(); ++it) {
+        dst.push_back(*it);
+    }
+}
+
+bool
+WW::planFor(const state_t& state, const WW::StepList& order, SolveContext& context, WW::StepList& out_plan, int& out_cost, bool scanToEnd)
+{
+    out_cost = solveForSequence(state, order.begin(), order.end(), context, out_plan, scanToEnd);
+    int total = 0;
+    for (WW::StepList::const_iterator it = out_plan.begin(); it != out_plan.end(); ++it) {
+        total += it->cost();
+    }
+    // solveForSequence() fails with a cost of nothing and only part of the plan
+    return total == out_cost && out_plan.size() >= order.size();
+}
+
+bool
+WW::takeIfCheaper(const state_t& state, WW::StepList& order, SolveContext& context, WW::StepList& out_order, WW::StepList& out_plan, int& out_cost)
+{
+    WW::StepList plan;
+    int planCost = 0;
+    if (planFor(state, order, context, plan, planCost) && planCost < out_cost) {
+        out_plan.clear();
+        out_plan.splice(out_plan.end(), plan);
+        out_order.clear();
+        out_order.splice(out_order.end(), order);
+        out_cost = planCost;
+        return true;
+    }
+    return false;
+}
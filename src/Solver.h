@@ -0,0 +1,480 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_SOLVER_HEADER
+#define INCLUDE_WW_SOLVER_HEADER
+
+#include "Arena.h"
+#include "CompiledSteps.h"
+#include "FrameStack.h"
+#include "Plan.h"
+#include "SolveCache.h"
+#include "StateSearch.h"
+#include "StateTable.h"
+#include "StepList.h"
+#include "StepTable.h"
+#include "Steps.h"
+#include "ThreadPool.h"
+
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace WW
+{
+    class SolverThreads;
+    struct HubPlan;
+    struct HubTable;
+
+    /** The outcome of solving the dependencies of one candidate step */
+    struct CandidateOutcome
+    {
+        CandidateOutcome() : outcome(0), list(), pruned(false), truncated(false) {}
+        int outcome;
+        StepList list;
+        bool pruned; // abandoned; it could not be cheaper than another candidate, or than the bound
+        bool truncated; // possibly cut short by the depth limit
+    };
+
+    /** A solve in progress: the arguments and locals of what would be one
+     * level of recursion, kept on an explicit stack instead of the call
+     * stack.  Frames are recycled, so the buffers they have grown are reused
+     * by the solves which follow.
+     */
+    struct SolveFrame
+    {
+        enum phase_t {
+            START,      // nothing done yet
+            CANDIDATES, // choosing between the candidates, from `next` onwards
+            REMAINDER   // waiting for the solve of what the chosen candidate left to do
+        };
+
+        SolveFrame()
+            : state(), target(), chainStart(), chainEnd(), bound(0), memoize(false)
+            , phase(START), changes(), candidates(), present(), forked(), next(0), awaiting(false)
+            , bounded(false), solved(false), macroChosen(false), abandoned(false), immediate(0), hub(0), list(), candidateState()
+            , childCost(0), childList(), cost(0), result(), truncated(false)
+            , level(0), hash(0), shadows(0), cycleLevel(NO_CYCLE)
+            {}
+
+        void reset() {
+            state = StateId();
+            target = StateId();
+            phase = START;
+            changes.clear();
+            candidates.clear();
+            forked.clear();
+            next = 0;
+            awaiting = false;
+            solved = false;
+            macroChosen = false;
+            abandoned = false;
+            hub = 0;
+            list.clear();
+            childList.clear();
+            cost = 0;
+            result.clear();
+            truncated = false;
+            shadows = 0;
+            cycleLevel = NO_CYCLE;
+        }
+
+        static const size_t NO_CYCLE = static_cast<size_t>(-1);
+
+    private: // forbid copy and assignment
+        SolveFrame(const SolveFrame& copy);
+        SolveFrame& operator=(const SolveFrame& copy);
+
+    public:
+
+        // arguments
+        StateId state;
+        StateId target;
+        StepList::const_iterator chainStart;
+        StepList::const_iterator chainEnd;
+        int bound;
+        bool memoize; // a solve without a chain, whose outcome goes in the memo
+
+        // locals
+        phase_t phase;
+        state_t changes;
+        StepTable::indices_t candidates;
+        StepTable::mask_t present;
+        std::vector<CandidateOutcome> forked;
+        size_t next; // candidate being considered
+        bool awaiting; // the solve of the dependencies of candidate `next`
+        bool bounded;
+        bool solved;
+        bool macroChosen; // the cheapest so far is a macro step, which loses a tie
+        bool abandoned;
+        int immediate;
+        const HubPlan* hub; // from the hub table, which bounds the solve, if it has one
+        Plan list; // solution using candidate `next`
+        StateId candidateState;
+
+        // outcome of the last solve this one waited for
+        int childCost;
+        Plan childList;
+
+        // outcome
+        int cost;
+        Plan result;
+        bool truncated; // some solve it depends on was cut short by the depth limit, so it is not final
+
+        // place among the solves in progress
+        size_t level; // on the frame stack
+        size_t hash; // of what it solves
+        SolveFrame* shadows; // an identical solve suspended beneath the search this belongs to
+        size_t cycleLevel; // the shallowest solve found to need itself by any this one depends on
+    };
+
+    typedef FrameStack<SolveFrame> frames_t;
+
+    /** Solves in progress, identified by what they solve, so that a solve
+     * which comes to need itself can be recognised in constant time.
+     */
+    struct FrameHash
+    {
+        size_t operator()(const SolveFrame* frame) const { return frame->hash; }
+    };
+
+    struct FrameEqual
+    {
+        bool operator()(const SolveFrame* lhs, const SolveFrame* rhs) const {
+            return lhs->hash == rhs->hash && lhs->chainStart == rhs->chainStart && lhs->chainEnd == rhs->chainEnd && lhs->state == rhs->state && lhs->target == rhs->target;
+        }
+    };
+
+    typedef std::unordered_set<SolveFrame*, FrameHash, FrameEqual, ArenaAllocator<SolveFrame*> > in_progress_t;
+
+    struct SequenceHash
+    {
+        size_t operator()(const std::vector<size_t>& sequence) const {
+            size_t result = sequence.size();
+            for (std::vector<size_t>::const_iterator it = sequence.begin(); it != sequence.end(); ++it) {
+                result ^= *it + 0x9e3779b9 + (result << 6) + (result >> 2);
+            }
+            return result;
+        }
+    };
+
+    typedef std::unordered_map<std::vector<size_t>, unsigned int, SequenceHash> sequences_t;
+
+    typedef SolveCache<StateId, Plan> memo_t;
+
+    /** A step list kept for reuse, as a frame of a FrameStack */
+    struct ListBuffer
+    {
+        ListBuffer() : list() {}
+        void reset() { list.clear(); }
+        StepList list;
+    };
+
+    /** State used by the solver functions on a single thread for the
+     * duration of a calculate().  The compiled steps are shared; the memo
+     * of solutions is private to the thread, so no locking is needed.
+     *
+     * Partial plans are made by one arena, released by each solve as it
+     * returns, and the plans in the memo are copied to another, which is
+     * reset along with the memo.
+     *
+     * The solves in progress, the memo and the state space search refer to
+     * states by their ids in the thread's state table, which is cleared
+     * along with the memo too.
+     */
+    struct SolveContext
+    {
+        SolveContext(const CompiledSteps& compiled, SolverThreads& threads);
+
+        const CompiledSteps& compiled;
+        SolverThreads& threads;
+        const AttributeTable& attributes;
+        const std::vector<const TestStep*>& steps;
+        const std::vector<operation_t>& operations;
+        const StepTable& stepTable;
+        PlanArena plans; // partial plans of the solves in progress
+        PlanArena memoPlans; // plans in the memo
+        StateTable states;
+        std::vector<StateId> dependencies; // of each step, once interned
+        StateTable searched; // states reached by the state space search in progress
+        memo_t cache;
+        const StepList noChain; // empty, for solving without a subsequent chain
+        unsigned int depth; // of nested solves in progress
+        unsigned long pruned; // candidates abandoned by branch and bound
+        unsigned long searchesAbandoned; // state space searches too large to complete
+        std::unordered_map<state_t, Relevance, StateHash> relevance; // by target, for the state space search
+        SolveCache<StateId> searchCache; // searches, by state reduced to the relevant keys
+        frames_t frames; // solves in progress
+        in_progress_t inProgress; // the frames, by what they solve
+        size_t searchBase; // frames beneath this belong to searches suspended on this thread
+        unsigned long cyclesCut; // solves not run, being needed by themselves
+        unsigned long depthExceeded; // solves not run, being nested more deeply than the limit
+        bool truncated; // the last solve was cut short by the depth limit, so is not final
+        sequences_t sequences; // sub-plans memoized, as step indices, by how many solves found them
+        StepList buffer; // steps of a plan being copied, or of a search's solution
+        FrameStack<ListBuffer> lists; // for ScratchList
+
+        const operation_t& operation(const TestStep& step) const { return compiled.operation(step); }
+
+    private: // forbid copy and assignment
+        SolveContext(const SolveContext& copy);
+        SolveContext& operator=(const SolveContext& copy);
+    };
+
+    /** A step list from the context's recycled buffers, for the lifetime
+     * of the object, so that the plans which are built only to be measured,
+     * or to be solved from, rarely need to allocate.
+     */
+    class ScratchList
+    {
+    public:
+        explicit ScratchList(SolveContext& context) : m_context(context), m_list(context.lists.push().list) {}
+        ~ScratchList() { m_context.lists.pop(); }
+
+    private: // forbid copy and assignment
+        ScratchList(const ScratchList& copy);
+        ScratchList& operator=(const ScratchList& copy);
+
+    public:
+        StepList& list() { return m_list; }
+
+    private:
+        SolveContext& m_context;
+        StepList& m_list;
+    };
+
+    /** Starts a search on a context, for the lifetime of the object, at
+     * the given solve depth.  The search is independent of any suspended
+     * beneath it on the same thread, so is blind to their solves in progress.
+     */
+    class ScopedSearch
+    {
+    public:
+        ScopedSearch(SolveContext& context, unsigned int depth)
+            : m_context(context)
+            , m_depth(context.depth)
+            , m_base(context.searchBase)
+            {
+                context.depth = depth;
+                context.searchBase = context.frames.size();
+            }
+        ~ScopedSearch() { m_context.depth = m_depth; m_context.searchBase = m_base; }
+
+    private: // forbid copy and assignment
+        ScopedSearch(const ScopedSearch& copy);
+        ScopedSearch& operator=(const ScopedSearch& copy);
+
+    private:
+        SolveContext& m_context;
+        unsigned int m_depth;
+        size_t m_base;
+    };
+
+    /** An arena for each thread of a calculate(), or none, to hold the
+     * solver's temporaries until the calculation returns.  The calling
+     * thread's arena is current for the lifetime of the object, so it must
+     * be made before anything the solver allocates.
+     */
+    class SolverArenas
+    {
+    public:
+        SolverArenas(unsigned int threads, bool use)
+            : m_threads(threads)
+            , m_arenas()
+            , m_scope(make(use))
+            {}
+
+    private: // forbid copy and assignment
+        SolverArenas(const SolverArenas& copy);
+        SolverArenas& operator=(const SolverArenas& copy);
+
+    public:
+        unsigned int threads() const { return m_threads; }
+        /** The arena for `worker`, or zero */
+        Arena* arena(unsigned int worker) const { return m_arenas.empty() ? 0 : m_arenas[worker].get(); }
+
+    private:
+        Arena* make(bool use) {
+            for (unsigned int worker = 0; use && worker < m_threads; ++worker) {
+                m_arenas.push_back(std::unique_ptr<Arena>(new Arena));
+            }
+            return arena(0);
+        }
+
+    private:
+        unsigned int m_threads;
+        std::vector<std::unique_ptr<Arena> > m_arenas;
+        ScopedArena m_scope;
+    };
+
+    /** A pool of threads, each with its own SolveContext over the same
+     * compiled steps, and its own arena if there are any.  Worker zero is
+     * the calling thread.
+     */
+    class SolverThreads
+    {
+    public:
+        SolverThreads(const CompiledSteps& compiled, const SolverArenas& arenas, Steps::Engine engine, unsigned int depthLimit, bool learnMacros);
+
+    private: // forbid copy and assignment
+        SolverThreads(const SolverThreads& copy);
+        SolverThreads& operator=(const SolverThreads& copy);
+
+    public:
+        ThreadPool& pool() { return m_pool; }
+        SolveContext& context(unsigned int worker) { return *m_contexts[worker]; }
+        Steps::Engine engine() const { return m_engine; }
+        unsigned int depthLimit() const { return m_depthLimit; }
+        bool learnMacros() const { return m_learnMacros; }
+        const HubTable* hubs() const { return m_hubs; }
+        void setHubs(const HubTable* hubs) { m_hubs = hubs; }
+        /** Solve cache statistics summed over every thread */
+        memo_t::Stats stats() const;
+        /** Candidates abandoned by branch and bound on every thread */
+        unsigned long pruned() const;
+        /** State space searches abandoned on every thread */
+        unsigned long searchesAbandoned() const;
+        /** Solves not run on any thread for being nested beyond the depth limit */
+        unsigned long depthExceeded() const;
+        /** Solves not run on any thread for being needed by themselves */
+        unsigned long cyclesCut() const;
+        /** The most solves in progress at once on any thread */
+        size_t deepestStack() const;
+
+    private:
+        ThreadPool m_pool;
+        std::vector<std::unique_ptr<SolveContext> > m_contexts;
+        Steps::Engine m_engine;
+        unsigned int m_depthLimit;
+        bool m_learnMacros;
+        const HubTable* m_hubs; // or zero, until worked out
+    };
+
+    /** A bound on the cost of a solve which is no bound at all */
+    const int UNBOUNDED = std::numeric_limits<int>::max();
+
+    /** Returned, with an empty solution, by a solve which could find nothing
+     * cheaper than its bound.  Like a failure, but not a final answer.
+     */
+    const int BOUND_EXCEEDED = std::numeric_limits<int>::max();
+
+    /** Apply the operations of each of `steps` to `state`, in turn */
+    void applyState(state_t& state, const StepList& steps, const SolveContext& context);
+
+    /** The state reached by running `steps` from `state`, by the context's state table */
+    StateId applyState(const StateId& state, const Plan& steps, SolveContext& context);
+
+    /** Solve without regard to any subsequent chain of steps.
+     *
+     * The outcome depends only on `state`, `target` and the available steps,
+     * so it is memoized for the rest of the calculation.  A solve abandoned
+     * because of its bound is not a final answer, so is not memoized.
+     */
+    int solve(const state_t& state, const state_t& target, SolveContext& context, StepList& out_result, int bound = UNBOUNDED);
+
+    int solve(const state_t& state, const state_t& target, SolveContext& context, StepList& out_result, StepList::const_iterator chainStart, StepList::const_iterator chainEnd);
+
+    /** Steps of a sequence, the first being the one solved for, which guide
+     * the solve for its dependencies when solveForSequence() looks ahead
+     */
+    const size_t LOOK_AHEAD = 16;
+
+    /** Solve for running each step from `begin` to `end` in turn, starting
+     * in `startState`; zero if a step can not be solved.  With `scanToEnd`,
+     * the solve for each step looks ahead along those which follow it,
+     * `LOOK_AHEAD` steps in all.
+     */
+    int solveForSequence(const state_t& startState, StepList::const_iterator begin, StepList::const_iterator end, SolveContext& context, StepList& out_result, bool scanToEnd = false);
+
+    /** The state before each position of a sequence, and the cost of
+     * reaching it.  `states[i]` is the state before item `i` is run, and the
+     * final entry is the state once the whole sequence has been run.
+     */
+    struct SequenceWalk
+    {
+        SequenceWalk() : states(), costs() {}
+        std::vector<state_t> states;
+        std::vector<int> costs;
+    };
+
+    /** Record, in `out_walk`, the state and the cost so far at each position of `sequence` */
+    void walkSequence(const state_t& startState, const StepList& sequence, SolveContext& context, SequenceWalk& out_walk);
+
+    /** Cost of running the sequence from `position` onwards, starting in
+     * `state`, which is left wherever the run stops.
+     *
+     * This gives the same cost as solveForSequence(), but stops as soon as
+     * `state` matches the state `walk` recorded at the same position; from
+     * there on everything is as it was, so the remaining cost is known.
+     * `out_failed` is set when not even the first item could be solved,
+     * which is when solveForSequence() would produce an empty solution.
+     */
+    int solveSuffix(state_t& state, StepList::const_iterator it, StepList::const_iterator end, size_t position, const SequenceWalk& walk, SolveContext& context, bool& out_failed);
+
+    /** Add each of `src` to the end of `dst` */
+    void append(StepList& dst, const StepList& src);
+
+    /** Work out the plan which runs `order` from `state`; false if there
+     * is none.  Without `scanToEnd` it does not look ahead, which is
+     * quicker but may cost more.
+     */
+    bool planFor(const state_t& state, const StepList& order, SolveContext& context, StepList& out_plan, int& out_cost, bool scanToEnd = true);
+
+    /** Replace `out_plan`, which runs `out_order` for `out_cost`, with the
+     * plan for `order` if that is cheaper.
+     */
+    bool takeIfCheaper(const state_t& state, StepList& order, SolveContext& context, StepList& out_order, StepList& out_plan, int& out_cost);
+
+    /** Reports how many of the required steps have been placed in a
+     * sequence, from whichever threads are placing them.
+     */
+    class Progress
+    {
+    public:
+        Progress(size_t total, bool show) : m_mutex(), m_total(total), m_placed(0), m_show(show) {}
+
+    private: // forbid copy and assignment
+        Progress(const Progress& copy);
+        Progress& operator=(const Progress& copy);
+
+    public:
+        void start() {
+            if (m_show) {
+                std::cerr << "Compiling:    ";
+            }
+        }
+        /** Another step is about to be placed */
+        void place() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            unsigned int percent = m_placed++ * 100 / m_total;
+            if (m_show) {
+                std::cerr << "\b\b\b" << std::setw(2) << percent << "%";
+            }
+        }
+        void finish() {
+            if (m_show) {
+                std::cerr << "\b\b\bdone!" << std::endl;
+            }
+        }
+        void abandon() {
+            if (m_show) {
+                std::cerr << std::endl;
+            }
+        }
+
+    private:
+        std::mutex m_mutex;
+        size_t m_total;
+        size_t m_placed;
+        bool m_show;
+    };
+}
+
+#endif // INCLUDE_WW_SOLVER_HEADER
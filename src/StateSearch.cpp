@@ -0,0 +1,253 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "StateSearch.h"
+
+#include "Hubs.h"
+#include "Solver.h"
+
+#include <algorithm>
+#include <functional>
+
+typedef WW::state_t state_t;
+
+namespace {
+
+    /** States expanded by a state space search before it is abandoned */
+    const size_t SEARCH_LIMIT = 20000;
+
+    /** Lower bound on the cost of reaching `target` from `state`, or
+     * UNBOUNDED if no step can change an attribute which needs to change.
+     *
+     * Every attribute still to change needs a step which changes its key,
+     * so the dearest of the cheapest such steps is a lower bound.  Since a
+     * step leaves the keys it doesn't change as they were, the estimate
+     * falls by no more than the cost of any step; it is consistent.
+     */
+    int
+        estimateCost(const state_t& state, const state_t& target, const WW::CompiledSteps& compiled)
+        {
+            state_t missing;
+            state_t::find_changes(state, target, missing);
+            int result = 0;
+            for (state_t::const_iterator it = missing.begin(); it != missing.end(); ++it) {
+                int cost = (it->key() < compiled.keyCost.size()) ? compiled.keyCost[it->key()] : WW::UNBOUNDED;
+                if (cost == WW::UNBOUNDED) {
+                    return WW::UNBOUNDED;
+                }
+                result = std::max(result, cost);
+            }
+            return result;
+        }
+
+    /** A state reached by the search, and how it was reached */
+    struct SearchNode
+    {
+        SearchNode(const WW::StateId& state, int cost, size_t parent, size_t step) : state(state), cost(cost), parent(parent), step(step) {}
+        static const size_t ROOT = static_cast<size_t>(-1); // parent of the start
+        WW::StateId state;
+        int cost;
+        size_t parent; // index of the node this was reached from
+        size_t step; // index of the step which reached it from the parent
+    };
+
+    typedef std::vector<SearchNode, WW::ArenaAllocator<SearchNode> > search_nodes_t;
+
+    /** Add the steps by which the search reached `node` to `out_result` */
+    void
+        appendPath(const search_nodes_t& nodes, size_t node, const WW::CompiledSteps& compiled, WW::StepList& out_result)
+        {
+            std::vector<size_t> path;
+            for (size_t n = node; nodes[n].parent != SearchNode::ROOT; n = nodes[n].parent) {
+                path.push_back(nodes[n].step);
+            }
+            for (std::vector<size_t>::const_reverse_iterator it = path.rbegin(); it != path.rend(); ++it) {
+                out_result.push_back(*compiled.steps[*it]);
+            }
+        }
+}
+
+const WW::Relevance&
+WW::relevance(const state_t& target, SolveContext& context)
+{
+    std::unordered_map<state_t, Relevance, StateHash>::iterator found = context.relevance.find(target);
+    if (found != context.relevance.end()) {
+        return found->second;
+    }
+
+    Relevance& result = context.relevance[target];
+    result.keys.assign(context.attributes.keyCount(), false);
+    for (state_t::const_iterator it = target.begin(); it != target.end(); ++it) {
+        result.keys[it->key()] = true;
+    }
+    std::vector<bool> used(context.operations.size(), false);
+    bool grown = true;
+    while (grown) {
+        grown = false;
+        for (size_t i = 0; i < context.operations.size(); ++i) {
+            if (used[i] || !context.compiled.reachable.canRun(i) || context.compiled.dominance[i] != UNDOMINATED || context.compiled.isMacro(i)) {
+                continue;
+            }
+            const state_t& changes = context.operations[i].changes();
+            for (state_t::const_iterator it = changes.begin(); it != changes.end(); ++it) {
+                if (result.keys[it->key()]) {
+                    used[i] = grown = true;
+                    break;
+                }
+            }
+            if (used[i]) {
+                const state_t& dependencies = context.operations[i].dependencies();
+                for (state_t::const_iterator it = dependencies.begin(); it != dependencies.end(); ++it) {
+                    result.keys[it->key()] = true;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < used.size(); ++i) {
+        if (used[i]) {
+            result.steps.push_back(i);
+            result.changes.push_back(state_t());
+            const state_t& changes = context.operations[i].changes();
+            for (state_t::const_iterator it = changes.begin(); it != changes.end(); ++it) {
+                if (result.keys[it->key()]) {
+                    result.changes.back().insert(*it);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void
+WW::project(const state_t& state, const Relevance& relevant, state_t& out_result)
+{
+    out_result.clear();
+    for (state_t::const_iterator it = state.begin(); it != state.end(); ++it) {
+        if (it->key() < relevant.keys.size() && relevant.keys[it->key()]) {
+            out_result.insert(*it);
+        }
+    }
+}
+
+bool
+WW::searchStates(const state_t& state, const state_t& target, SolveContext& context, WW::StepList& out_result, int bound, int& out_cost)
+{
+    typedef std::pair<int, size_t> open_t; // estimated total cost, node
+    const CompiledSteps& compiled = context.compiled;
+
+    out_result.clear();
+    const Relevance& relevant = relevance(target, context);
+    state_t reduced;
+    project(state, relevant, reduced);
+    const WW::StateId start = context.states.intern(reduced);
+    const WW::StateId goal = context.states.intern(target);
+    if (context.searchCache.find(start, goal, out_cost, out_result)) {
+        return true;
+    }
+    const Hub* hub = (context.threads.hubs() != 0) ? context.threads.hubs()->find(target) : 0;
+    if (hub != 0) {
+        std::unordered_map<state_t, HubPlan, StateHash>::const_iterator found = hub->plans.find(reduced);
+        if (found != hub->plans.end()) {
+            out_cost = found->second.cost;
+            out_result = found->second.plan;
+            context.searchCache.insert(start, goal, out_cost, out_result);
+            return true;
+        }
+    }
+
+    WW::StateTable& states = context.searched;
+    states.clear();
+    search_nodes_t nodes;
+    std::vector<size_t, WW::ArenaAllocator<size_t> > visited; // node of each state, by index, or ROOT if none
+    std::vector<open_t, WW::ArenaAllocator<open_t> > open;
+    WW::StepTable::mask_t present;
+    state_t missing;
+    const HubPlan* shortcut = 0; // finishing the cheapest solution through a hub plan
+    size_t shortcutNode = SearchNode::ROOT;
+    int shortcutCost = UNBOUNDED;
+
+    int estimate = estimateCost(reduced, target, compiled);
+    if (estimate == UNBOUNDED) {
+        out_cost = 1; // as solve(), failure is a non-zero cost without steps
+        context.searchCache.insert(start, goal, out_cost, out_result);
+        return true;
+    }
+    nodes.push_back(SearchNode(states.intern(reduced), 0, SearchNode::ROOT, 0));
+    visited.push_back(0);
+    open.push_back(open_t(estimate, 0));
+
+    size_t expanded = 0;
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), std::greater<open_t>());
+        open_t best = open.back();
+        open.pop_back();
+        if (visited[nodes[best.second].state.index()] != best.second) {
+            continue; // superseded by a cheaper way of reaching the same state
+        }
+
+        const SearchNode& node = nodes[best.second];
+        state_t::find_changes(states.attributes(node.state), target, missing);
+        if (shortcut != 0 && best.first >= shortcutCost && !(missing.empty() && node.cost <= shortcutCost)) {
+            appendPath(nodes, shortcutNode, compiled, out_result);
+            append(out_result, shortcut->plan);
+            out_cost = shortcutCost;
+            context.searchCache.insert(start, goal, out_cost, out_result);
+            return true;
+        }
+        if (best.first >= bound) {
+            out_cost = BOUND_EXCEEDED;
+            return true;
+        }
+        if (missing.empty()) {
+            appendPath(nodes, best.second, compiled, out_result);
+            out_cost = node.cost;
+            context.searchCache.insert(start, goal, out_cost, out_result);
+            return true;
+        }
+        if (++expanded > SEARCH_LIMIT) {
+            return false;
+        }
+
+        compiled.stepTable.stateMask(states.attributes(node.state), present);
+        const size_t parent = best.second;
+        for (size_t i = 0; i < relevant.steps.size(); ++i) {
+            const size_t step = relevant.steps[i];
+            if (!compiled.stepTable.isValid(step, present)) {
+                continue;
+            }
+            const WW::StateId next = states.apply(nodes[parent].state, relevant.changes[i]);
+            int cost = nodes[parent].cost + compiled.steps[step]->cost();
+            visited.resize(states.size(), static_cast<size_t>(SearchNode::ROOT));
+            size_t& reached = visited[next.index()];
+            if (reached != SearchNode::ROOT && nodes[reached].cost <= cost) {
+                continue;
+            }
+            const state_t& attributes = states.attributes(next);
+            int remaining = estimateCost(attributes, target, compiled);
+            if (remaining == UNBOUNDED) {
+                continue;
+            }
+            size_t index = nodes.size();
+            if (hub != 0) {
+                std::unordered_map<state_t, HubPlan, StateHash>::const_iterator plan = hub->plans.find(attributes);
+                if (plan != hub->plans.end()) {
+                    remaining = std::max(remaining, plan->second.cost);
+                    if (cost + plan->second.cost < shortcutCost) {
+                        shortcut = &plan->second;
+                        shortcutNode = index;
+                        shortcutCost = cost + plan->second.cost;
+                    }
+                }
+            }
+            nodes.push_back(SearchNode(next, cost, parent, step));
+            reached = index;
+            open.push_back(open_t(cost + remaining, index));
+            std::push_heap(open.begin(), open.end(), std::greater<open_t>());
+        }
+    }
+    out_cost = 1;
+    context.searchCache.insert(start, goal, out_cost, out_result);
+    return true;
+}
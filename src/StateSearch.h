@@ -0,0 +1,66 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_STATESEARCH_HEADER
+#define INCLUDE_WW_STATESEARCH_HEADER
+
+#include "CompiledSteps.h"
+#include "StepList.h"
+#include "StepTable.h"
+
+#include <vector>
+
+namespace WW
+{
+    struct SolveContext;
+
+    /** The attribute keys, and the steps, which could play any part in
+     * reaching a target: those changing a key of the target, and, in turn,
+     * those changing a key which one of those depends on.  Macro steps play
+     * no part, since the search would find the same cost through their
+     * members, but could settle a tie differently.
+     */
+    struct Relevance
+    {
+        Relevance() : keys(), steps(), changes() {}
+        std::vector<bool> keys; // by key id
+        StepTable::indices_t steps; // in store order
+        std::vector<state_t> changes; // of each of `steps`, only to the relevant keys
+    };
+
+    /** The relevance of every key and step to reaching `target`, worked out
+     * once for each target by each context
+     */
+    const Relevance& relevance(const state_t& target, SolveContext& context);
+
+    /** `state` without the attributes whose keys are not relevant */
+    void project(const state_t& state, const Relevance& relevant, state_t& out_result);
+
+    /** A* search of the state space for the cheapest steps from `state` to
+     * any state satisfying `target`.
+     *
+     * Only the relevant steps are tried, and states are reduced to the
+     * relevant keys; the others cannot affect which relevant steps are valid
+     * nor whether the target is met, so states differing only in those are
+     * one and the same to the search.  A step which is not relevant can be
+     * left out of any solution, making it no dearer.  The states reached are
+     * interned, so each is identified by its index in the order reached, and
+     * the hash of each is worked out from the one it was reached from.
+     *
+     * The open list is a binary heap ordered by estimated total cost, then
+     * by the order in which states were reached, so the outcome is
+     * repeatable.  Each state is kept once, with the cheapest cost found to
+     * reach it.  Returns false, having found nothing, if SEARCH_LIMIT states
+     * are expanded before the search completes.
+     *
+     * If the target is a hub target, the cost of the hub table's plan from
+     * a state is exact, so is a better estimate from there, and the plan
+     * finishes a solution through that state.  The cheapest such solution
+     * is taken once nothing open could be cheaper.
+     */
+    bool searchStates(const state_t& state, const state_t& target, SolveContext& context, StepList& out_result, int bound, int& out_cost);
+}
+
+#endif // INCLUDE_WW_STATESEARCH_HEADER
@@ -0,0 +1,154 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "StateTable.h"
+
+namespace {
+    /** Rough overhead of a node of an unordered container */
+    const size_t NODE_SIZE = 4 * sizeof(void*);
+}
+
+WW::StateTable::StateTable()
+: m_states()
+, m_byHash()
+, m_transitions()
+, m_working()
+, m_journal()
+, m_path()
+, m_memoryUsed(0)
+{
+}
+
+uint64_t
+WW::StateTable::mix(uint64_t x)
+{
+    // the splitmix64 finaliser
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+uint64_t
+WW::StateTable::key(const AttributeId& attribute)
+{
+    return mix((static_cast<uint64_t>(attribute.key()) << 32) ^ (static_cast<uint64_t>(attribute.compoundValue()) << 1) ^ (attribute.isForbidden() ? 1 : 0));
+}
+
+uint64_t
+WW::StateTable::hash(const attributes_t& attributes)
+{
+    uint64_t result = 0;
+    for (attributes_t::const_iterator it = attributes.begin(); it != attributes.end(); ++it) {
+        result ^= key(*it);
+    }
+    return result;
+}
+
+WW::StateId
+WW::StateTable::intern(const attributes_t& attributes)
+{
+    return insert(hash(attributes), attributes);
+}
+
+WW::StateId
+WW::StateTable::apply(const StateId& state, const attributes_t& changes)
+{
+    if (!rewind(state)) {
+        m_working = m_states[state.m_index].attributes;
+        m_journal.clear();
+        m_path.clear();
+        Visit visit = { state.m_index, 0 };
+        m_path.push_back(visit);
+    }
+    const size_t mark = m_journal.size();
+    m_working.applyChanges(changes, m_journal);
+
+    // Each change recorded replaced or removed any attribute with its key
+    uint64_t hash = state.m_hash;
+    for (attributes_t::journal_t::const_iterator it = m_journal.begin() + mark; it != m_journal.end(); ++it) {
+        if (it->present) {
+            hash ^= key(it->previous);
+        }
+        attributes_t::const_iterator added = m_working.find(it->key);
+        if (added != m_working.end()) {
+            hash ^= key(*added);
+        }
+    }
+    StateId result = insert(hash, m_working);
+
+    if (m_path.size() == MAX_PATH) {
+        m_journal.clear();
+        m_path.clear();
+    }
+    Visit visit = { result.m_index, m_journal.size() };
+    m_path.push_back(visit);
+    return result;
+}
+
+bool
+WW::StateTable::rewind(const StateId& state)
+{
+    for (size_t visit = m_path.size(); visit > 0; --visit) {
+        if (m_path[visit - 1].state == state.m_index) {
+            m_working.undo(m_journal, m_path[visit - 1].mark);
+            m_path.resize(visit);
+            return true;
+        }
+    }
+    return false;
+}
+
+WW::StateId
+WW::StateTable::follow(const StateId& state, const attributes_t& changes)
+{
+    Transition transition = { state.m_index, &changes };
+    transitions_t::const_iterator found = m_transitions.find(transition);
+    if (found != m_transitions.end()) {
+        return StateId(found->second, m_states[found->second].hash);
+    }
+    StateId result = apply(state, changes);
+    m_transitions.insert(transitions_t::value_type(transition, result.m_index));
+    m_memoryUsed += NODE_SIZE + sizeof(transitions_t::value_type);
+    return result;
+}
+
+WW::StateId
+WW::StateTable::insert(uint64_t hash, const attributes_t& attributes)
+{
+    by_hash_t::iterator found = m_byHash.find(hash);
+    unsigned int next = StateId::NONE;
+    if (found != m_byHash.end()) {
+        for (unsigned int index = found->second; index != StateId::NONE; index = m_states[index].next) {
+            if (m_states[index].attributes == attributes) {
+                return StateId(index, hash);
+            }
+        }
+        next = found->second;
+    }
+    unsigned int index = static_cast<unsigned int>(m_states.size());
+    m_states.push_back(State(attributes, hash, next));
+    m_memoryUsed += sizeof(State) + attributes.size() * sizeof(AttributeId);
+    if (found != m_byHash.end()) {
+        found->second = index;
+    }
+    else {
+        m_byHash.insert(by_hash_t::value_type(hash, index));
+        m_memoryUsed += NODE_SIZE + sizeof(by_hash_t::value_type);
+    }
+    return StateId(index, hash);
+}
+
+void
+WW::StateTable::clear()
+{
+    m_states.clear();
+    m_journal.clear();
+    m_path.clear();
+    // rather than clear(), which would go over every bucket they have grown
+    by_hash_t().swap(m_byHash);
+    transitions_t().swap(m_transitions);
+    m_memoryUsed = 0;
+}
@@ -0,0 +1,154 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_STATETABLE_HEADER
+#define INCLUDE_WW_STATETABLE_HEADER
+
+#include "attributeid.h"
+
+#include <deque>
+#include <functional>
+#include <stdint.h>
+#include <unordered_map>
+
+namespace WW
+{
+    /** A state interned by a StateTable.  Two ids from the same table are
+     * equal exactly when their states are, and an id carries the hash of its
+     * state, so both take constant time.
+     */
+    class StateId
+    {
+    public:
+        StateId() : m_index(NONE), m_hash(0) {}
+
+    public:
+        bool operator==(const StateId& rhs) const { return m_index == rhs.m_index; }
+        bool operator!=(const StateId& rhs) const { return m_index != rhs.m_index; }
+        size_t hash() const { return static_cast<size_t>(m_hash); }
+        /** Whether this is the id of a state, rather than of none */
+        bool valid() const { return m_index != NONE; }
+        /** Ids are numbered from zero in the order their states were interned */
+        unsigned int index() const { return m_index; }
+
+    private:
+        friend class StateTable;
+        StateId(unsigned int index, uint64_t hash) : m_index(index), m_hash(hash) {}
+
+        static const unsigned int NONE = static_cast<unsigned int>(-1);
+
+    private:
+        unsigned int m_index;
+        uint64_t m_hash;
+    };
+
+    /** Memory held by a cache key beyond the key itself; an id holds none,
+     * its state being held by the table.  See SolveCache.
+     */
+    inline size_t heapSize(const StateId&) { return 0; }
+
+    /** Interns states, so that each distinct set of attributes is held once.
+     *
+     * The hash of a state is the exclusive or of a pseudo-random key for each
+     * of its attributes, so applying a change only needs the keys of the
+     * attributes it adds and those it replaces.
+     *
+     * The state last reached is kept, along with a journal of what was
+     * displaced on the way to it from the states before, so applying changes
+     * to that state or to one it was reached from, as a search does when it
+     * goes deeper or tries a sibling, costs time in proportion to the changes
+     * rather than to the size of the state.  Following a set of changes
+     * from a state also remembers the outcome, so following them again takes
+     * constant time; changes are told apart by their address, so must
+     * outlive the table's contents.
+     *
+     * Ids are only valid until the table is cleared.  Not thread safe; its
+     * memory comes from the calling thread's current Arena, if it has one.
+     */
+    class StateTable
+    {
+    public:
+        typedef Attributes<AttributeId> attributes_t;
+
+    public:
+        ~StateTable() {}
+        StateTable();
+
+    private: // forbid copy and assignment
+        StateTable(const StateTable& copy);
+        StateTable& operator=(const StateTable& copy);
+
+    public:
+        StateId intern(const attributes_t& attributes);
+        /** The state reached by applying `changes` to `state` */
+        StateId apply(const StateId& state, const attributes_t& changes);
+        /** As apply(), remembering the outcome for the next time */
+        StateId follow(const StateId& state, const attributes_t& changes);
+        /** The attributes of `state`; stays valid as other states are interned */
+        const attributes_t& attributes(const StateId& state) const { return m_states[state.m_index].attributes; }
+
+        /** Forget every state, invalidating their ids */
+        void clear();
+
+        size_t size() const { return m_states.size(); }
+        /** Approximate memory occupied by the states and the changes remembered */
+        size_t memoryUsed() const { return m_memoryUsed; }
+
+        /** The key of a single attribute */
+        static uint64_t key(const AttributeId& attribute);
+        /** The hash of a set of attributes, as an id of it carries */
+        static uint64_t hash(const attributes_t& attributes);
+
+    private:
+        StateId insert(uint64_t hash, const attributes_t& attributes);
+        /** Undo changes to the working state until it is `state`; false if it never was */
+        bool rewind(const StateId& state);
+        /** Spread every bit of `x` over every bit of the result */
+        static uint64_t mix(uint64_t x);
+
+        struct State
+        {
+            State(const attributes_t& attributes, uint64_t hash, unsigned int next) : attributes(attributes), hash(hash), next(next) {}
+            attributes_t attributes;
+            uint64_t hash;
+            unsigned int next; // another state with the same hash, or NONE
+        };
+
+        struct Transition
+        {
+            unsigned int state;
+            const attributes_t* changes;
+            bool operator==(const Transition& rhs) const { return state == rhs.state && changes == rhs.changes; }
+        };
+        struct TransitionHash
+        {
+            size_t operator()(const Transition& transition) const {
+                return static_cast<size_t>(mix(reinterpret_cast<uintptr_t>(transition.changes) * 0x9e3779b97f4a7c15ULL + transition.state));
+            }
+        };
+
+        typedef std::deque<State, ArenaAllocator<State> > states_t;
+        typedef std::unordered_map<uint64_t, unsigned int, std::hash<uint64_t>, std::equal_to<uint64_t>, ArenaAllocator<std::pair<const uint64_t, unsigned int> > > by_hash_t;
+        typedef std::unordered_map<Transition, unsigned int, TransitionHash, std::equal_to<Transition>, ArenaAllocator<std::pair<const Transition, unsigned int> > > transitions_t;
+
+    private:
+        states_t m_states; // by index; a deque, so growing moves none
+        by_hash_t m_byHash; // the last state interned with each hash
+        transitions_t m_transitions; // to the state reached
+        attributes_t m_working; // the state last reached by apply()
+        attributes_t::journal_t m_journal; // what was displaced on the way to it
+        struct Visit
+        {
+            unsigned int state;
+            size_t mark; // length of the journal once it was reached
+        };
+        std::vector<Visit> m_path; // the states it was reached through, then itself
+        size_t m_memoryUsed;
+
+        static const size_t MAX_PATH = 64; // longer paths are forgotten, to keep the journal short
+    };
+}
+
+#endif // INCLUDE_WW_STATETABLE_HEADER
@@ -9,10 +9,14 @@
 #include "TestStep.h"
 
 #include <algorithm>
-#include <list>
+#include <vector>
 
 namespace WW
 {
+    /** A sequence of steps, each held by its address; contiguous, so
+     * iterators are random access, copies are a single allocation, and
+     * splicing into an empty list takes the other list's storage.
+     */
     class StepList
     {
     public:
@@ -22,12 +26,12 @@ namespace WW
         typedef const value_type& const_reference;
         typedef value_type* pointer;
         typedef const value_type* const_pointer;
-        typedef std::list<const_pointer> container_t;
+        typedef std::vector<const_pointer> container_t;
 
         class iterator : public std::iterator<
-            std::bidirectional_iterator_tag,
+            std::random_access_iterator_tag,
             StepList::value_type,
-            TestStep::size_type,
+            std::ptrdiff_t,
             StepList::pointer,
             StepList::reference>
             {
@@ -41,6 +45,7 @@ namespace WW
             public:
                 reference operator*() const { return **m_current; }
                 pointer operator->() const { return *m_current; }
+                reference operator[](difference_type n) const { return *m_current[n]; }
                 iterator& operator++()
                     {
                         ++m_current;
@@ -63,11 +68,16 @@ namespace WW
                     {
                         return iterator(m_current--);
                     }
+                iterator& operator+=(difference_type n) { m_current += n; return *this; }
+                iterator& operator-=(difference_type n) { m_current -= n; return *this; }
+                iterator operator+(difference_type n) const { return iterator(m_current + n); }
+                iterator operator-(difference_type n) const { return iterator(m_current - n); }
+                difference_type operator-(const iterator& other) const { return m_current - other.m_current; }
             };
         class const_iterator : public std::iterator<
-            std::bidirectional_iterator_tag,
+            std::random_access_iterator_tag,
             const StepList::value_type,
-            TestStep::size_type,
+            std::ptrdiff_t,
             const StepList::pointer,
             const StepList::reference>
             {
@@ -80,8 +90,9 @@ namespace WW
             public:
                 it_t base() const { return m_current; }
             public:
-                reference operator*() { return **m_current; }
-                pointer operator->() { return *m_current; }
+                reference operator*() const { return **m_current; }
+                pointer operator->() const { return *m_current; }
+                reference operator[](difference_type n) const { return *m_current[n]; }
                 const_iterator& operator++()
                     {
                         ++m_current;
@@ -104,6 +115,11 @@ namespace WW
                     {
                         return const_iterator(m_current--);
                     }
+                const_iterator& operator+=(difference_type n) { m_current += n; return *this; }
+                const_iterator& operator-=(difference_type n) { m_current -= n; return *this; }
+                const_iterator operator+(difference_type n) const { return const_iterator(m_current + n); }
+                const_iterator operator-(difference_type n) const { return const_iterator(m_current - n); }
+                difference_type operator-(const const_iterator& other) const { return m_current - other.m_current; }
             };
 
         typedef std::reverse_iterator<iterator> reverse_iterator;
@@ -114,6 +130,11 @@ namespace WW
         StepList(const StepList& copy) : m_contents(copy.m_contents) {}
         StepList(const StepList::container_t& copy) : m_contents(copy) {}
         StepList(const_iterator it1, const_iterator it2) : m_contents(it1.base(), it2.base()) {}
+#if __cplusplus >= 201103L
+        StepList(StepList&& other) noexcept : m_contents(std::move(other.m_contents)) {}
+        StepList& operator=(StepList&& other) noexcept { m_contents.swap(other.m_contents); return *this; }
+#endif
+        StepList& operator=(const StepList& copy) { m_contents = copy.m_contents; return *this; }
 
     private:
         container_t m_contents;
@@ -135,18 +156,42 @@ namespace WW
 #endif
     public:
         void clear() { return m_contents.clear(); }
-        bool empty() { return m_contents.empty(); }
+        bool empty() const { return m_contents.empty(); }
+        /** Move every step of `__x` before `__position`, leaving `__x` empty.
+         * Storage is taken from `__x` only when there is not enough here.
+         */
 #if __cplusplus >= 201103L
-        void splice(const_iterator __position, StepList&& __x) noexcept { m_contents.splice(__position.base(), __x.m_contents); }
-        void splice(const_iterator __position, StepList& __x) noexcept { m_contents.splice(__position.base(), __x.m_contents); }
+        void splice(const_iterator __position, StepList&& __x) noexcept { splice(__position, __x); }
+        void splice(const_iterator __position, StepList& __x) noexcept {
+            if (m_contents.empty() && m_contents.capacity() < __x.m_contents.size()) {
+                m_contents.swap(__x.m_contents);
+            }
+            else {
+                m_contents.insert(__position.base(), __x.m_contents.begin(), __x.m_contents.end());
+            }
+            __x.m_contents.clear();
+        }
 #else
-        void splice(iterator __position, StepList& __x) { m_contents.splice(__position.base(), __x.m_contents); }
+        void splice(iterator __position, StepList& __x) {
+            if (m_contents.empty() && m_contents.capacity() < __x.m_contents.size()) {
+                m_contents.swap(__x.m_contents);
+            }
+            else {
+                m_contents.insert(__position.base(), __x.m_contents.begin(), __x.m_contents.end());
+            }
+            __x.m_contents.clear();
+        }
 #endif
 
         size_type size() const { return m_contents.size(); }
-        void erase(iterator position) { m_contents.erase(position.base()); }
-        void erase(iterator first, iterator last) { m_contents.erase(first.base(), last.base()); }
+        void reserve(size_type count) { m_contents.reserve(count); }
+        reference operator[](size_type index) const { return *m_contents[index]; }
+        reference front() const { return *m_contents.front(); }
+        reference back() const { return *m_contents.back(); }
+        iterator erase(iterator position) { return iterator(m_contents.erase(position.base())); }
+        iterator erase(iterator first, iterator last) { return iterator(m_contents.erase(first.base(), last.base())); }
         void push_back(reference val) { m_contents.push_back(&val); }
+        void pop_back() { m_contents.pop_back(); }
 #if __cplusplus >= 201103L
         iterator insert(const_iterator pos, const value_type& val) { return iterator(m_contents.insert(pos.base(), &val)); }
 #else
@@ -154,11 +199,7 @@ namespace WW
 #endif
         const_iterator find(const_reference val) const { return std::find(begin(), end(), val); }
         iterator find(reference val) { return std::find(begin(), end(), val); }
-        void append(const StepList& steps) {
-            for (container_t::const_iterator it = steps.m_contents.begin(); it != steps.m_contents.end(); ++it) {
-                m_contents.push_back(*it);
-            }
-        }
+        void append(const StepList& steps) { m_contents.insert(m_contents.end(), steps.m_contents.begin(), steps.m_contents.end()); }
     };
 
     inline bool operator==(const StepList::iterator lhs, const StepList::iterator rhs) {
@@ -177,6 +218,14 @@ namespace WW
         return lhs.base() != rhs.base();
     }
 
+    inline bool operator<(const StepList::iterator lhs, const StepList::iterator rhs) {
+        return lhs.base() < rhs.base();
+    }
+
+    inline bool operator<(const StepList::const_iterator lhs, const StepList::const_iterator rhs) {
+        return lhs.base() < rhs.base();
+    }
+
     inline StepList operator+(const StepList& lhs, const StepList& rhs) {
         StepList result(lhs);
         result.append(rhs);
@@ -220,38 +269,6 @@ namespace WW
 
 }
 
-inline WW::StepList::const_iterator
-operator+(WW::StepList::const_iterator it, int count)
-{
-    if (count > 0) {
-        while (--count > 0) {
-            ++it;
-        }
-    }
-    else if (count < 0) {
-        while (++count < 0) {
-            --it;
-        }
-    }
-    return it;
-}
-
-inline WW::StepList::const_iterator
-operator-(WW::StepList::const_iterator it, int count)
-{
-    if (count > 0) {
-        while (--count > 0) {
-            --it;
-        }
-    }
-    else if (count < 0) {
-        while (++count < 0) {
-            ++it;
-        }
-    }
-    return it;
-}
-
 template <class Iter>
 struct iterator_traits {
     typedef typename Iter::value_type value_type;
@@ -0,0 +1,216 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "StepTable.h"
+
+#include <algorithm>
+
+namespace {
+    struct Contains
+    {
+        explicit Contains(const WW::StepTable::indices_t& sorted) : m_sorted(sorted) {}
+        bool operator()(size_t value) const { return std::binary_search(m_sorted.begin(), m_sorted.end(), value); }
+        const WW::StepTable::indices_t& m_sorted;
+    };
+}
+
+// Masks are stored word-major: word `w` of operation `op` lives at
+// `w * m_size + op`.  The scans below therefore walk each array
+// contiguously with a single broadcast word from the query, which is the
+// shape the compiler is able to vectorize.
+
+WW::StepTable::StepTable()
+: m_bits()
+, m_size(0)
+, m_words(0)
+, m_required()
+, m_forbidden()
+, m_adds()
+, m_removes()
+, m_providers()
+, m_none()
+{
+}
+
+WW::StepTable::StepTable(const std::vector<operation_t>& operations)
+: m_bits()
+, m_size(0)
+, m_words(0)
+, m_required()
+, m_forbidden()
+, m_adds()
+, m_removes()
+, m_providers()
+, m_none()
+{
+    assign(operations);
+}
+
+size_t
+WW::StepTable::addBit(const AttributeId& attribute)
+{
+    std::pair<std::unordered_map<uint64_t, size_t>::iterator, bool> result = m_bits.insert(std::make_pair(slot(attribute), m_bits.size()));
+    return result.first->second;
+}
+
+bool
+WW::StepTable::bit(const AttributeId& attribute, size_t& out_bit) const
+{
+    std::unordered_map<uint64_t, size_t>::const_iterator it = m_bits.find(slot(attribute));
+    if (it == m_bits.end()) {
+        return false;
+    }
+    out_bit = it->second;
+    return true;
+}
+
+void
+WW::StepTable::assign(const std::vector<operation_t>& operations)
+{
+    m_bits.clear();
+    for (std::vector<operation_t>::const_iterator op = operations.begin(); op != operations.end(); ++op) {
+        for (ids_t::const_iterator it = op->dependencies().begin(); it != op->dependencies().end(); ++it) {
+            addBit(*it);
+        }
+        for (ids_t::const_iterator it = op->changes().begin(); it != op->changes().end(); ++it) {
+            addBit(*it);
+        }
+    }
+
+    m_size = operations.size();
+    m_words = (m_bits.size() + WORD_BITS - 1) / WORD_BITS;
+    m_required.assign(m_words * m_size, 0);
+    m_forbidden.assign(m_words * m_size, 0);
+    m_adds.assign(m_words * m_size, 0);
+    m_removes.assign(m_words * m_size, 0);
+    m_providers.assign(m_bits.size() * 2, indices_t());
+
+    for (size_t op = 0; op < m_size; ++op) {
+        const operation_t& operation = operations[op];
+        for (ids_t::const_iterator it = operation.dependencies().begin(); it != operation.dependencies().end(); ++it) {
+            size_t b = m_bits.find(slot(*it))->second;
+            (it->isForbidden() ? m_forbidden : m_required)[(b / WORD_BITS) * m_size + op] |= word_t(1) << (b % WORD_BITS);
+        }
+        for (ids_t::const_iterator it = operation.changes().begin(); it != operation.changes().end(); ++it) {
+            size_t b = m_bits.find(slot(*it))->second;
+            (it->isForbidden() ? m_removes : m_adds)[(b / WORD_BITS) * m_size + op] |= word_t(1) << (b % WORD_BITS);
+            m_providers[b * 2 + (it->isForbidden() ? 1 : 0)].push_back(op);
+        }
+    }
+}
+
+void
+WW::StepTable::stateMask(const ids_t& state, mask_t& out_present) const
+{
+    out_present.assign(m_words, 0);
+    for (ids_t::const_iterator it = state.begin(); it != state.end(); ++it) {
+        size_t b = 0;
+        if (!it->isForbidden() && bit(*it, b)) {
+            set(&out_present[0], b);
+        }
+    }
+}
+
+void
+WW::StepTable::changeMasks(const ids_t& changes, mask_t& out_adds, mask_t& out_removes) const
+{
+    out_adds.assign(m_words, 0);
+    out_removes.assign(m_words, 0);
+    for (ids_t::const_iterator it = changes.begin(); it != changes.end(); ++it) {
+        size_t b = 0;
+        if (bit(*it, b)) {
+            set(&(it->isForbidden() ? out_removes : out_adds)[0], b);
+        }
+    }
+}
+
+bool
+WW::StepTable::isValid(size_t operation, const mask_t& present) const
+{
+    word_t missing = 0;
+    for (size_t w = 0; w < m_words; ++w) {
+        size_t i = w * m_size + operation;
+        missing |= (m_required[i] & ~present[w]) | (m_forbidden[i] & present[w]);
+    }
+    return missing == 0;
+}
+
+void
+WW::StepTable::findValid(const mask_t& present, indices_t& out_result) const
+{
+    out_result.clear();
+    mask_t missing(m_size, 0);
+    for (size_t w = 0; w < m_words; ++w) {
+        const word_t p = present[w];
+        const word_t* required = &m_required[w * m_size];
+        const word_t* forbidden = &m_forbidden[w * m_size];
+        for (size_t op = 0; op < m_size; ++op) {
+            missing[op] |= (required[op] & ~p) | (forbidden[op] & p);
+        }
+    }
+    for (size_t op = 0; op < m_size; ++op) {
+        if (missing[op] == 0) {
+            out_result.push_back(op);
+        }
+    }
+}
+
+const WW::StepTable::indices_t&
+WW::StepTable::providers(const AttributeId& attribute) const
+{
+    size_t b = 0;
+    if (!bit(attribute, b)) {
+        return m_none;
+    }
+    return m_providers[b * 2 + (attribute.isForbidden() ? 1 : 0)];
+}
+
+void
+WW::StepTable::findProviding(const ids_t& changes, indices_t& out_result) const
+{
+    out_result.clear();
+    indices_t contradicts;
+    for (ids_t::const_iterator it = changes.begin(); it != changes.end(); ++it) {
+        const indices_t& provide = providers(*it);
+        out_result.insert(out_result.end(), provide.begin(), provide.end());
+        const indices_t& contradict = providers(it->forbidden(!it->isForbidden()));
+        contradicts.insert(contradicts.end(), contradict.begin(), contradict.end());
+    }
+    if (changes.size() > 1) {
+        std::sort(out_result.begin(), out_result.end());
+        out_result.erase(std::unique(out_result.begin(), out_result.end()), out_result.end());
+    }
+    if (!contradicts.empty()) {
+        std::sort(contradicts.begin(), contradicts.end());
+        indices_t::iterator end = std::remove_if(out_result.begin(), out_result.end(), Contains(contradicts));
+        out_result.erase(end, out_result.end());
+    }
+}
+
+void
+WW::StepTable::findProviding(const mask_t& adds, const mask_t& removes, indices_t& out_result) const
+{
+    out_result.clear();
+    mask_t provides(m_size, 0);
+    mask_t contradicts(m_size, 0);
+    for (size_t w = 0; w < m_words; ++w) {
+        const word_t a = adds[w];
+        const word_t r = removes[w];
+        if ((a | r) == 0) {
+            continue;
+        }
+        const word_t* opAdds = &m_adds[w * m_size];
+        const word_t* opRemoves = &m_removes[w * m_size];
+        for (size_t op = 0; op < m_size; ++op) {
+            provides[op] |= (opAdds[op] & a) | (opRemoves[op] & r);
+            contradicts[op] |= (opAdds[op] & r) | (opRemoves[op] & a);
+        }
+    }
+    for (size_t op = 0; op < m_size; ++op) {
+        if (provides[op] != 0 && contradicts[op] == 0) {
+            out_result.push_back(op);
+        }
+    }
+}
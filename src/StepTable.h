@@ -0,0 +1,100 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_STEPTABLE_HEADER
+#define INCLUDE_WW_STEPTABLE_HEADER
+
+#include "Arena.h"
+#include "AttributeTable.h"
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace WW
+{
+    /** Dense bitmask representation of a set of interned operations.
+     *
+     * Every distinct attribute (key and compound value) used by any operation
+     * is given a bit.  Each operation is stored as four masks: the attributes
+     * it requires, the attributes it forbids, the attributes it adds and the
+     * attributes it removes.  The masks for all operations are held in
+     * contiguous arrays, one per kind, so that testing every operation against
+     * a state is a branch-free scan of AND/ANDNOT operations over whole words.
+     *
+     * Attributes which no operation mentions have no bit; they can never make
+     * an operation valid or invalid, nor can they be provided.
+     *
+     * An inverted index from each bit, added or removed, to the operations
+     * which change it allows providers to be found without a scan.  The index
+     * is keyed on the compound value as well as the key, so `key=other` is
+     * never taken to provide `key=value`, matching Attributes::containsAny().
+     *
+     * Masks and lists of indices, which the solver makes many of, take their
+     * memory from the calling thread's current Arena, if it has one.
+     */
+    class StepTable
+    {
+    public:
+        typedef uint64_t word_t;
+        typedef std::vector<word_t, ArenaAllocator<word_t> > mask_t;
+        typedef AttributeTable::ids_t ids_t;
+        typedef AttributeTable::id_operation_t operation_t;
+        typedef std::vector<size_t, ArenaAllocator<size_t> > indices_t;
+
+        static const size_t WORD_BITS = sizeof(word_t) * 8;
+
+    public:
+        ~StepTable() {}
+        StepTable();
+        explicit StepTable(const std::vector<operation_t>& operations);
+
+    public:
+        void assign(const std::vector<operation_t>& operations);
+
+        size_t size() const { return m_size; }
+        size_t words() const { return m_words; }
+        size_t bits() const { return m_bits.size(); }
+
+        /** Mask of the attributes present (and not forbidden) in `state` */
+        void stateMask(const ids_t& state, mask_t& out_present) const;
+        /** Split `changes` into masks of attributes to be added and removed */
+        void changeMasks(const ids_t& changes, mask_t& out_adds, mask_t& out_removes) const;
+
+        /** Equivalent to Operation::isValid() */
+        bool isValid(size_t operation, const mask_t& present) const;
+        /** Indices of every operation valid in the state `present` */
+        void findValid(const mask_t& present, indices_t& out_result) const;
+        /** Indices, in ascending order, of every operation whose changes
+         * provide any of `changes` without contradicting any; equivalent to
+         * `changes().containsAny(changes)`.  Uses the provider index, so
+         * the cost is proportional to the number of providers.
+         */
+        void findProviding(const ids_t& changes, indices_t& out_result) const;
+        /** As above, but by scanning the masks of every operation */
+        void findProviding(const mask_t& adds, const mask_t& removes, indices_t& out_result) const;
+        /** Operations which add (or remove, if `forbidden`) an attribute */
+        const indices_t& providers(const AttributeId& attribute) const;
+
+    private:
+        bool bit(const AttributeId& attribute, size_t& out_bit) const;
+        size_t addBit(const AttributeId& attribute);
+        static void set(word_t* mask, size_t bit) { mask[bit / WORD_BITS] |= word_t(1) << (bit % WORD_BITS); }
+        static uint64_t slot(const AttributeId& attribute) { return (static_cast<uint64_t>(attribute.key()) << 32) | attribute.compoundValue(); }
+
+    private:
+        std::unordered_map<uint64_t, size_t> m_bits;
+        size_t m_size;
+        size_t m_words;
+        mask_t m_required;
+        mask_t m_forbidden;
+        mask_t m_adds;
+        mask_t m_removes;
+        std::vector<indices_t> m_providers; // indexed by bit * 2 + forbidden
+        indices_t m_none;
+    };
+}
+
+#endif // INCLUDE_WW_STEPTABLE_HEADER
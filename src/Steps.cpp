@@ -5,9 +5,25 @@
 
 #include "Steps.h"
 
+#include "AttributeTable.h"
+#include "BeamSearch.h"
+#include "CompiledSteps.h"
+#include "ExactOrder.h"
+#include "Hubs.h"
+#include "Insertion.h"
+#include "LocalSearch.h"
+#include "Macros.h"
+#include "Ordering.h"
+#include "Plan.h"
+#include "Portfolio.h"
+#include "Reachability.h"
+#include "Solver.h"
+#include "StateSearch.h"
 #include "StepList.h"
 #include "TestException.h"
+#include "ThreadPool.h"
 
+#include <algorithm>
 #include <deque>
 #include <iomanip>
 #include <iostream>
@@ -15,6 +31,9 @@
 #include <set>
 #include <map>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <time.h>
 
@@ -27,6 +46,20 @@ typedef std::list<WW::TestStep> stepstore_t;
 typedef std::set<string_t> compound_attributes_t;
 typedef std::map<string_t, compound_attributes_t> compound_map_t;
 typedef std::list<attributes_t> att_list_t;
+typedef WW::AttributeTable::ids_t state_t; // interned attributes used by the solver
+typedef WW::AttributeTable::id_operation_t operation_t;
+
+/** A plan of the hub table, as saved: the cheapest steps from a state to a
+ * hub target
+ */
+struct SavedHubPlan
+{
+    SavedHubPlan() : target(), state(), cost(0), steps() {}
+    attributes_t target;
+    attributes_t state; // only the attributes which matter to reaching the target
+    int cost;
+    std::vector<std::string> steps; // the signature of each
+};
 
 template <typename Stream>
 Stream& operator<<(Stream& str, const compound_attributes_t& ob) {
@@ -87,7 +120,23 @@ public:
     Impl()
         : m_startState()
         , m_allSteps()
+        , m_attributes()
         , m_showProgress(true)
+        , m_threads(0)
+        , m_engine(WW::Steps::RECURSIVE)
+        , m_depthLimit(DEFAULT_DEPTH_LIMIT)
+        , m_exactLimit(0)
+        , m_beamWidth(1)
+        , m_searchTime(0)
+        , m_searchSeed(0)
+        , m_portfolioTime(0)
+        , m_arenas(true)
+        , m_learnMacros(false)
+        , m_macros()
+        , m_hubs(0)
+        , m_hubKey()
+        , m_hubPlans()
+        , m_stats()
         {}
     ~Impl() {}
 
@@ -101,322 +150,324 @@ public:
     void add(std::istream& str);
     stepstore_t& allSteps() { return m_allSteps; }
     const stepstore_t& allSteps() const { return m_allSteps; }
-    void setState(const attributes_t& state) { m_startState = state; }
+    void setState(const attributes_t& state) { m_startState = state; m_attributes.intern(state); }
     void setShowProgress(bool showProgress) { m_showProgress = showProgress; }
+    void setThreads(unsigned int threads) { m_threads = threads; }
+    void setEngine(WW::Steps::Engine engine) { m_engine = engine; }
+    void setDepthLimit(unsigned int depth) { m_depthLimit = depth; }
+    void setExactLimit(unsigned int steps) { m_exactLimit = steps; }
+    void setBeamWidth(unsigned int width) { m_beamWidth = width; }
+    void setLocalSearch(unsigned int milliseconds, unsigned int seed) { m_searchTime = milliseconds; m_searchSeed = seed; }
+    void setPortfolio(unsigned int milliseconds) { m_portfolioTime = milliseconds; }
+    void setArenas(bool use) { m_arenas = use; }
+    void setLearnMacros(bool learn) { m_learnMacros = learn; }
+    void loadMacros(std::istream& ist);
+    void saveMacros(std::ostream& ost) const;
+    void setHubs(unsigned int hubs) { m_hubs = hubs; }
+    void loadHubs(std::istream& ist);
+    void saveHubs(std::ostream& ost) const;
 
     WW::StepList calculate() const;
+    const WW::Steps::Stats& stats() const { return m_stats; }
 
 private:
     attributes_t m_startState;
     mutable stepstore_t m_allSteps;
+    mutable WW::AttributeTable m_attributes; // interned as steps are loaded
     bool m_showProgress;
+    unsigned int m_threads; // zero for one per hardware thread
+    WW::Steps::Engine m_engine;
+    unsigned int m_depthLimit;
+    unsigned int m_exactLimit;
+    unsigned int m_beamWidth;
+    unsigned int m_searchTime; // milliseconds
+    unsigned int m_searchSeed;
+    unsigned int m_portfolioTime; // milliseconds
+    bool m_arenas;
+    bool m_learnMacros;
+    mutable std::vector<macro_t> m_macros; // grows as calculate() learns more
+    unsigned int m_hubs;
+    mutable std::string m_hubKey; // of the steps, start and hubs the plans were computed for
+    mutable std::vector<SavedHubPlan> m_hubPlans;
+    mutable WW::Steps::Stats m_stats;
+
+    static const unsigned int DEFAULT_DEPTH_LIMIT = 10000;
 };
 
 namespace {
 
-    WW::StepList findStepsProviding(const stepstore_t& steps, const attributes_t& attributes)
-    {
-        WW::StepList result;
-        for (stepstore_t::const_iterator it = steps.begin(); it != steps.end(); ++it)
+    /** Order the `pending` steps, then work out the steps needed before
+     * each, so they can run in turn from `state`.
+     *
+     * With a beam wider than one, the plan for the cheapest order of the
+     * beam is only taken if it is cheaper than the plan for the order found
+     * by inserting each step in turn, which the beam also keeps.  Likewise
+     * the plan for the order local search improves that to is only taken if
+     * it is cheaper.  A component small enough is ordered exactly instead,
+     * which local search can not improve on.
+     */
+    int
+        solveSequence(const state_t& state, const WW::StepList& pending, WW::SolverThreads& threads, const WW::OrderOptions& options, WW::StepList& out_result, WW::OrderStats& out_stats, WW::Progress& progress)
         {
-            if (it->operation().changes().containsAny(attributes))
-            {
-                result.push_back(*it);
+            WW::SolveContext& context = threads.context(threads.pool().worker());
+            WW::StepList order;
+            int cost = 0;
+            const bool exact = WW::solveExactly(state, pending, threads, options.exactLimit, WW::Deadline(), order, out_result, cost, out_stats);
+            if (exact) {
+                for (size_t i = 0; i < pending.size(); ++i) {
+                    progress.place();
+                }
+            }
+            else if (options.beamWidth <= 1) {
+                WW::orderByInsertion(state, pending, threads, WW::Deadline(), order, progress);
+                cost = WW::solveForSequence(state, order.begin(), order.end(), context, out_result, true);
+            }
+            else {
+                WW::StepList best;
+                WW::orderByBeam(state, pending, threads, options.beamWidth, WW::Deadline(), best, order, progress);
+                cost = WW::solveForSequence(state, order.begin(), order.end(), context, out_result, true);
+                if (!std::equal(best.begin(), best.end(), order.begin())) {
+                    WW::takeIfCheaper(state, best, context, order, out_result, cost);
+                }
             }
-        }
-        return result;
-    }
-
-    void
-        applyState(attributes_t& state, const WW::StepList& steps)
-        {
-            for (WW::StepList::const_iterator it = steps.begin(); it != steps.end(); ++it) {
-#ifdef DEBUG
-                if (!it->operation().isValid(state))
-                {
-                    std::ostringstream ost;
-
-                    attributes_t cr;
-
-                    attributes_t::find_changes(state, it->operation().dependencies(), cr);
 
-                    ost << "ERROR: unexpectedly unable to apply solved state " << *it << " " << it->operation() << " onto " << state << ".  Missing " << cr;
-                    throw WW::TestException(ost.str().c_str());
+            if (options.searchTime > 0 && !exact) {
+                out_stats.before = cost;
+                WW::StepList improved(order);
+                WW::improveOrder(state, improved, threads, options, WW::Deadline(options.searchTime), out_stats);
+                if (!std::equal(improved.begin(), improved.end(), order.begin())) {
+                    WW::takeIfCheaper(state, improved, context, order, out_result, cost);
                 }
-#endif
-                it->operation().modify(state);
+                out_stats.after = cost;
             }
+            return cost;
         }
 
-    int solve(const attributes_t& state, const attributes_t& target, const stepstore_t& steps, WW::StepList& out_result);
-    int
-        solveOrThrow(const attributes_t& state, const attributes_t& target, const stepstore_t& steps, WW::StepList& out_result)
+    size_t
+        findRoot(std::vector<size_t>& parents, size_t key)
         {
-            int cost = solve(state, target, steps, out_result);
-            if (cost > 0 && out_result.empty()) {
-                attributes_t cr;
-
-                attributes_t::find_changes(state, target, cr);
-
-                std::ostringstream ost;
-                ost << "No solution, need these dependencies defined: " << cr << " to get from " << state << " to " << target;
-                throw WW::TestException(ost.str().c_str());
+            while (parents[key] != key) {
+                parents[key] = parents[parents[key]];
+                key = parents[key];
             }
-            return cost;
+            return key;
         }
 
-    int solveForSequence(const attributes_t& startState, WW::StepList::const_iterator begin, WW::StepList::const_iterator end, const stepstore_t& steps, WW::StepList& out_result, bool scanToEnd = false);
-
-    /** solve
-     * @params state        starting state
-     * @params target       set of desired attributes
-     * @params steps        list of available steps
-     * @params out_result   results to return
-
-     * Determine the cheapest set of steps to iterate from state to target.  This function will be called recursively
+    /** Split the `pending` steps into components which are independent of
+     * one another: no step which could be needed for one component has an
+     * attribute key in common with any step which could be needed for
+     * another.  Components are in order of their first pending step, and
+     * keep the pending steps in order.
      */
-    int
-        solve(const attributes_t& state, const attributes_t& target, const stepstore_t& steps, WW::StepList& out_result, WW::StepList::const_iterator chainStart, WW::StepList::const_iterator chainEnd)
+    void
+        findComponents(const WW::StepList& pending, const WW::CompiledSteps& compiled, std::vector<WW::StepList>& out_components)
         {
-            out_result.clear();
-            // DBGOUT("solve(state=" << state << ", target=" << target << ", steps, out_result, chainStart, chainEnd) " << WW::StepList(chainStart, chainEnd));
-            attributes_t changes_required;
-            attributes_t::find_changes(state, target, changes_required);
-            if (changes_required.size() == 0)
-            {
-                return 0;
+            // Join the keys of every step into one set, with the union-find
+            // structure in `parents`
+            std::vector<size_t> parents(compiled.attributes.keyCount());
+            for (size_t key = 0; key < parents.size(); ++key) {
+                parents[key] = key;
             }
-            WW::StepList candidates = findStepsProviding(steps, changes_required);
-            if (candidates.size() == 0)
-            {
-                // This one is unusable
-                std::ostringstream ost;
-                ost << "No step defined which provides attributes " << changes_required;
-                return 99999;
-            }
-
-            int cost = 0;
-            bool solved = false;
-            attributes_t missing_attributes;
-            for (WW::StepList::const_iterator it = candidates.begin(); it != candidates.end(); ++it)
-            {
-                WW::StepList list;
-                int outcome = 0;
-                if (it->operation().isValid(state))
-                {
-                    // we don't need to search, it is immediately valid
-                    outcome = it->cost();
-                }
-                else
-                {
-                    outcome = it->cost() + solve(state, it->operation().dependencies(), steps, list, chainStart, chainEnd);
-                    if (outcome > 0 && list.empty()) {
-                        // No solution was found
-                        attributes_t cd;
-                        attributes_t::find_changes(state, it->operation().dependencies(), cd);
-                        missing_attributes.insert(cd.begin(), cd.end());
-                        continue;
-                    }
-                }
-                list.push_back(*it);
-
-                if (list.size() > 0) {
-                    if (chainStart != chainEnd) {
-                        // This isn't working because we are calculating the *dependencies* - we don't know the item to solve.  Can't do this here.
-                        attributes_t copy = state;
-                        applyState(copy, list);
-                        if (chainStart->operation().isValid(copy)) {
-                            // DBGOUT("  Solving remaining chain - cost=" << cost << ": " << list);
-                            WW::StepList tmp;
-                            cost += solveForSequence(copy, chainStart, chainEnd, steps, tmp, true);
-                            // DBGOUT("  Solved remaining chain - cost=" << cost << ": " << (list + tmp));
-                            // We want to see whether the solution satisfies target.
-                            // If it does, and if we have access to a list of remaining
-                            // elements, then we want to solve that list, to see
-                            // whether we can introduce a rule which will make that
-                            // subsequent chain even cheaper.  That remaining chain
-                            // need not be a full list; it could be just a fixed count,
-                            // an optimisation which ought to reduce the performance
-                            // overhead.
-
-                            // This function will all solveForSequence(), while that function
-                            // is still expected to call this one.  We need to limit
-                            // when this recursion happens, since in some cases we do
-                            // want it and in others it just isn't useful - or may even
-                            // be harmful.
-                            //
+            for (std::vector<operation_t>::const_iterator it = compiled.operations.begin(); it != compiled.operations.end(); ++it) {
+                const state_t* sets[] = { &it->dependencies(), &it->changes() };
+                size_t root = parents.size();
+                for (size_t set = 0; set < 2; ++set) {
+                    for (state_t::const_iterator attr = sets[set]->begin(); attr != sets[set]->end(); ++attr) {
+                        size_t other = findRoot(parents, attr->key());
+                        if (root == parents.size()) {
+                            root = other;
+                        }
+                        else if (other != root) {
+                            parents[other] = root;
                         }
-                    }
-
-                    if (list.size() > 0 && (out_result.size() == 0 || outcome < cost))
-                    {
-                        solved = true;
-                        cost = outcome;
-                        out_result = list;
                     }
                 }
             }
 
-            if (!solved) {
-                std::ostringstream ost;
-                ost << "No solution for " << changes_required << ", missing attributes: " << missing_attributes;
-                // throw WW::TestException(ost.str().c_str());
-                return 1;
-            }
-
-            if (out_result.empty())
-            {
-                return 1;
-            }
-
-            // cheapest should at this point be a sequence starting from
-            // `state`, but may not get us all the way to 'target'.  We call
-            // this function recursively at this point safely because we can't choose the same path, that set of attributes should already be satisfied.
-
-            attributes_t candidateState = state;
-            applyState(candidateState, out_result);
-            WW::StepList otherBits;
-            int solveCost = solve(candidateState, target, steps, otherBits);
-            if (solveCost > 0 && otherBits.empty()) {
-                // This solution doesn't work.
-                out_result.clear();
-                return 1;
+            out_components.clear();
+            std::unordered_map<size_t, size_t> components; // by root key
+            for (WW::StepList::const_iterator it = pending.begin(); it != pending.end(); ++it) {
+                const operation_t& operation = compiled.operation(*it);
+                const state_t& attributes = operation.dependencies().empty() ? operation.changes() : operation.dependencies();
+                size_t component = out_components.size();
+                if (!attributes.empty()) {
+                    component = components.insert(std::make_pair(findRoot(parents, attributes.begin()->key()), component)).first->second;
+                }
+                if (component == out_components.size()) {
+                    out_components.push_back(WW::StepList());
+                }
+                out_components[component].push_back(*it);
             }
-            cost += solveCost;
-            out_result.splice(out_result.end(), otherBits);
-            // DBGOUT("  solved: " << cost << ": " << out_result);
-            return cost;
         }
 
+    /** Construct the sequence of steps which runs every pending step.
+     *
+     * Components of the pending steps which share nothing are sequenced
+     * separately, in parallel, and their sequences run one after another.
+     * Whatever one does leaves the others unaffected, so this costs no more
+     * than any interleaving of them, and ordering each of several small
+     * components is much cheaper than ordering them all at once.
+     */
     int
-        solve(const attributes_t& state, const attributes_t& target, const stepstore_t& steps, WW::StepList& out_result)
+        solveAll(const state_t& state, const WW::StepList& pending, WW::SolverThreads& threads, const WW::OrderOptions& options, WW::StepList& out_result, WW::Steps::Stats& out_stats, bool showProgress = true)
         {
-            static WW::StepList dummy;
-            return solve(state, target, steps, out_result, dummy.end(), dummy.end());
-        }
-
-    void
-        append(WW::StepList& dst, const WW::StepList& src) {
-            for (WW::StepList::const_iterator it = src.begin(); it != src.end(); ++it) {
-                dst.push_back(*it);
+            std::vector<WW::StepList> components;
+            findComponents(pending, threads.context(0).compiled, components);
+            std::vector<WW::StepList> sequences(components.size());
+            std::vector<int> costs(components.size(), 0);
+            std::vector<WW::OrderStats> searches(components.size());
+
+            WW::Progress progress(pending.size(), showProgress);
+            progress.start();
+            try {
+                if (components.size() == 1) {
+                    costs[0] = (options.portfolio ? WW::solvePortfolio : solveSequence)(state, components[0], threads, options, sequences[0], searches[0], progress);
+                }
+                else {
+                    threads.pool().run(components.size(), [&](size_t component, unsigned int worker) {
+                        WW::ScopedSearch search(threads.context(worker), 0);
+                        costs[component] = (options.portfolio ? WW::solvePortfolio : solveSequence)(state, components[component], threads, options, sequences[component], searches[component], progress);
+                    });
+                }
             }
-        }
+            catch (...) {
+                progress.abandon();
+                throw;
+            }
+            progress.finish();
 
-    int
-        solveForSequence(const attributes_t& startState, WW::StepList::const_iterator begin, WW::StepList::const_iterator end, const stepstore_t& steps, WW::StepList& out_result, bool scanToEnd)
-        {
-            // DBGOUT("solveForSequence(state=" << startState << ", begin=" << *begin << ", end, steps, out_result, scanToEnd=" << scanToEnd << ") " << WW::StepList(begin, end));
-            out_result.clear();
-            attributes_t state = startState;
             int cost = 0;
-            WW::StepList::const_iterator scanEnd = begin;
-            for (int i = 0 ; (i < 15) && scanEnd != end ; ++i) {
-                ++scanEnd;
+            WW::OrderStats search;
+            for (size_t component = 0; component < components.size(); ++component) {
+                cost += costs[component];
+                out_result.splice(out_result.end(), sequences[component]);
+                search.exactTried += searches[component].exactTried;
+                search.exact += searches[component].exact;
+                search.before += searches[component].before;
+                search.after += searches[component].after;
+                search.tried += searches[component].tried;
+                search.taken += searches[component].taken;
+                for (size_t strategy = 0; strategy < WW::STRATEGY_COUNT; ++strategy) {
+                    search.wins[strategy] += searches[component].wins[strategy];
+                }
+                search.cutShort += searches[component].cutShort;
             }
-            for (WW::StepList::const_iterator it = begin; it != end; ++it) {
-                if (scanEnd != end) {
-                    ++scanEnd;
+            const WW::memo_t::Stats cache = threads.stats();
+            out_stats.components = components.size();
+            out_stats.cacheHits = cache.hits;
+            out_stats.cacheMisses = cache.misses;
+            out_stats.cacheEvictions = cache.evictions;
+            out_stats.pruned = threads.pruned();
+            out_stats.deepestStack = threads.deepestStack();
+            out_stats.depthExceeded = threads.depthExceeded();
+            out_stats.cyclesCut = threads.cyclesCut();
+            out_stats.searchesAbandoned = threads.searchesAbandoned();
+            out_stats.strategiesCutShort = search.cutShort;
+            if (showProgress) {
+                if (options.portfolio) {
+                    std::cerr << "Portfolio:";
+                    for (size_t strategy = 0; strategy < WW::STRATEGY_COUNT; ++strategy) {
+                        std::cerr << (strategy == 0 ? " " : ", ") << WW::STRATEGY_NAMES[strategy] << " won " << search.wins[strategy];
+                    }
+                    std::cerr << " components, " << search.cutShort << " strategies stopped by the deadline" << std::endl;
                 }
-                WW::StepList solution;
-                int item_cost = solve(state, it->operation().dependencies(), steps, solution, (scanToEnd ? it : scanEnd), scanEnd);
-                if (solution.size() > 0)
-                {
-                    cost += item_cost;
-                    applyState(state, solution);
-                    append(out_result, solution);
+                if (options.exactLimit > 0 || options.portfolio) {
+                    std::cerr << "Exact ordering: " << search.exact << " components ordered exactly, " << search.exactTried - search.exact << " given up" << std::endl;
                 }
-                else if (item_cost > 0) {
-                    return 0; // empty solution means failure
+                if (options.searchTime > 0) {
+                    std::cerr << "Local search: cost " << search.before << " before, " << search.after << " after, " << search.taken << " of " << search.tried << " moves taken" << std::endl;
                 }
-                cost += it->cost();
-                it->operation().modify(state);
-                out_result.push_back(*it);
             }
             return cost;
         }
 
-    WW::StepList::iterator
-        bestInsertionPoint(const attributes_t& startState, WW::StepList& sequence, const WW::TestStep& step, const stepstore_t& steps)
+    /** Remove the steps which can never run from `pending`, reporting each
+     * along with those of its dependencies which can never hold.
+     */
+    void
+        removeUnreachable(WW::StepList& pending, const WW::CompiledSteps& compiled, bool showProgress)
         {
-            // std::list::insert() requires a non-const iterator (fixed in
-            // C++11), which means this function must return a non-const
-            // iterator, which in turn means that sequence must be non-const.
-            // Please fix when moving to C++11.
-            // DBGOUT("bestInsertionPoint(startState, sequence=" << sequence << ", step=" << step << ", steps)");
-            WW::StepList solution;
-            attributes_t accumulated_state = startState;
-            WW::StepList::iterator insert_before = sequence.end();
-            int cheapest = 0;
-            int accumulated_cost = 0;
-
-            // We're going to run through the sequence from start to end,
-            // changing nothing.  We just remember and subsequently return the
-            // best insertion point.
-
-            for (WW::StepList::iterator it = sequence.begin(); it != sequence.end(); ++it) {
-                attributes_t state = accumulated_state;
-                int cost = accumulated_cost + solve(state, step.operation().dependencies(), steps, solution);
-                if (cost == 0 || !solution.empty()) {
-                    applyState(state, solution);
-                    cost += step.cost();
-                    step.operation().modify(state);
-                    cost += solveForSequence(state, it, sequence.end(), steps, solution);
-                    if (!solution.empty() && (insert_before == sequence.end() || cost < cheapest)) {
-                        cheapest = cost;
-                        insert_before = it;
-                    }
+            state_t missing;
+            WW::StepList::iterator it = pending.begin();
+            while (it != pending.end()) {
+                const operation_t& operation = compiled.operation(*it);
+                compiled.reachable.findUnreachable(operation.dependencies(), missing);
+                if (!missing.empty()) {
+                    std::cerr << "Unreachable: " << it->short_desc() << " needs " << compiled.attributes.names(missing) << std::endl;
+                    it = pending.erase(it);
                 }
-                {
-                    int cost = solveOrThrow(accumulated_state, it->operation().dependencies(), steps, solution);
-                    accumulated_cost += cost + it->cost();
+                else {
+                    ++it;
                 }
-                applyState(accumulated_state, solution);
-                it->operation().modify(accumulated_state);
             }
-            // We finally get to work out whether the best insertion point is right at the end.
-            {
-                int cost = solve(accumulated_state, step.operation().dependencies(), steps, solution);
-                if (cost == 0 || !solution.empty()) {
-                    accumulated_cost += cost + step.cost();
-                    if (accumulated_cost < cheapest) {
-                        insert_before = sequence.end();
+            if (showProgress) {
+                std::cerr << "Reachable: " << compiled.reachable.runnableCount() << " of " << compiled.steps.size() << " steps can run" << std::endl;
+            }
+        }
+
+    /** Identifies what hub plans are worked out for: the steps, whether
+     * each is required, the start state, and the number of hubs.  Any other
+     * would find different hubs, or could find cheaper plans between them.
+     */
+    std::string
+        hubKey(const stepstore_t& store, const attributes_t& start, unsigned int hubs)
+        {
+            std::ostringstream text;
+            for (stepstore_t::const_iterator it = store.begin(); it != store.end(); ++it) {
+                text << WW::signature(*it) << (it->required() ? " required" : "") << '\n';
+            }
+            text << start << '\n' << hubs;
+            return WW::hashText(text.str());
+        }
+
+    /** The hub table as saved */
+    void
+        saveHubTable(const WW::HubTable& table, const WW::AttributeTable& attributes, std::vector<SavedHubPlan>& out_saved)
+        {
+            out_saved.clear();
+            for (std::vector<WW::Hub>::const_iterator hub = table.hubs.begin(); hub != table.hubs.end(); ++hub) {
+                for (std::unordered_map<state_t, WW::HubPlan, WW::StateHash>::const_iterator it = hub->plans.begin(); it != hub->plans.end(); ++it) {
+                    out_saved.push_back(SavedHubPlan());
+                    SavedHubPlan& saved = out_saved.back();
+                    saved.target = attributes.names(hub->target);
+                    saved.state = attributes.names(it->first);
+                    saved.cost = it->second.cost;
+                    for (WW::StepList::const_iterator step = it->second.plan.begin(); step != it->second.plan.end(); ++step) {
+                        saved.steps.push_back(WW::signature(*step));
                     }
                 }
             }
-            return insert_before;
         }
 
-    int
-        solveAll(const attributes_t& state, const WW::StepList& pending, const stepstore_t& steps, WW::StepList& out_result, bool showProgress = true)
+    /** Rebuild the hub table from the plans saved, finding their steps
+     * among those of `store`.  Returns false if any step is missing.
+     */
+    bool
+        loadHubTable(const std::vector<SavedHubPlan>& saved, const stepstore_t& store, WW::AttributeTable& attributes, WW::SolveContext& context, WW::HubTable& out_table)
         {
-            WW::StepList order;
-
-            if (showProgress) {
-                std::cerr << "Compiling:    ";
+            std::unordered_map<std::string, const WW::TestStep*> steps;
+            for (stepstore_t::const_iterator it = store.begin(); it != store.end(); ++it) {
+                steps[WW::signature(*it)] = &*it;
             }
-            unsigned int count = pending.size();
-            unsigned int item = 0;
-            for (WW::StepList::const_iterator it = pending.begin(); it != pending.end(); ++it)
-            {
-                unsigned int percent = item++ * 100 / count;
-                if (showProgress) {
-                    std::cerr << "\b\b\b" << std::setw(2) << percent << "%";
+            const size_t keys = attributes.keyCount();
+            const size_t values = attributes.valueCount();
+            for (std::vector<SavedHubPlan>::const_iterator it = saved.begin(); it != saved.end(); ++it) {
+                const state_t target = attributes.intern(it->target);
+                const state_t state = attributes.intern(it->state);
+                if (attributes.keyCount() != keys || attributes.valueCount() != values) {
+                    return false; // an attribute no step has, which the compiled steps know nothing of
                 }
-                try {
-                    WW::StepList::iterator insert_point = bestInsertionPoint(state, order, *it, steps);
-                    order.insert(insert_point, *it);
-                }
-                catch (...) {
-                    if (showProgress) {
-                        std::cerr << std::endl;
+                WW::HubPlan& plan = out_table.add(target, context).plans[state];
+                plan.cost = it->cost;
+                for (std::vector<std::string>::const_iterator step = it->steps.begin(); step != it->steps.end(); ++step) {
+                    std::unordered_map<std::string, const WW::TestStep*>::const_iterator found = steps.find(*step);
+                    if (found == steps.end()) {
+                        return false;
                     }
-                    throw;
+                    plan.plan.push_back(*found->second);
                 }
             }
-            if (showProgress) {
-                std::cerr << "\b\b\bdone!" << std::endl;
-            }
-            return solveForSequence(state, order.begin(), order.end(), steps, out_result, true);
+            return true;
         }
 
     void
@@ -550,17 +601,168 @@ WW::Steps::Impl::calculate() const
 {
     //DBGOUT("calculate()");
 
+    m_stats = Steps::Stats();
+    SolverArenas arenas((m_threads == 0) ? ThreadPool::defaultSize() : m_threads, m_arenas);
     StepList pending;
     StepList chain;
 
     expandCompoundAttributes(m_allSteps);
     clone_required(m_allSteps, pending);
 
-    attributes_t state = m_startState;
-    solveAll(state, pending, m_allSteps, chain, m_showProgress);
+    std::vector<CompiledSteps::members_t> macros;
+    size_t invalidated = resolveMacros(m_allSteps, m_macros, macros);
+
+    state_t state = m_attributes.intern(m_startState);
+    CompiledSteps compiled(m_allSteps, macros, m_attributes, state);
+    removeUnreachable(pending, compiled, m_showProgress);
+    if (m_showProgress) {
+        size_t dominated = compiled.steps.size() - std::count(compiled.dominance.begin(), compiled.dominance.end(), UNDOMINATED);
+        size_t duplicated = std::count(compiled.dominance.begin(), compiled.dominance.end(), DUPLICATED);
+        std::cerr << "Dominated: " << dominated << " steps, " << duplicated << " of them duplicated" << std::endl;
+    }
+    SolverThreads threads(compiled, arenas, m_engine, m_depthLimit, m_learnMacros);
+
+    HubTable hubs;
+    if (m_hubs > 0 && compiled.nonNegativeCosts) {
+        const std::string key = hubKey(m_allSteps, m_startState, m_hubs);
+        const bool loaded = (key == m_hubKey) && loadHubTable(m_hubPlans, m_allSteps, m_attributes, threads.context(0), hubs);
+        if (!loaded) {
+            hubs = HubTable();
+            computeHubs(state, m_hubs, threads, compiled, hubs);
+            saveHubTable(hubs, m_attributes, m_hubPlans);
+            m_hubKey = key;
+        }
+        threads.setHubs(&hubs);
+        if (m_showProgress) {
+            std::cerr << "Hubs: " << hubs.hubs.size() << " targets, " << hubs.planCount() << " plans " << (loaded ? "loaded" : "worked out") << std::endl;
+        }
+    }
+    WW::OrderOptions order;
+    order.exactLimit = m_exactLimit;
+    order.beamWidth = m_beamWidth;
+    order.searchTime = m_searchTime;
+    order.seed = m_searchSeed;
+    if (m_portfolioTime > 0) {
+        order.portfolio = true;
+        order.searchTime = m_portfolioTime;
+    }
+    solveAll(state, pending, threads, order, chain, m_stats, m_showProgress);
+    expandMacros(chain, compiled);
+
+    std::vector<CompiledSteps::members_t> learned;
+    if (m_learnMacros) {
+        learnMacros(threads, compiled, learned);
+        for (std::vector<CompiledSteps::members_t>::const_iterator it = learned.begin(); it != learned.end(); ++it) {
+            macro_t macro;
+            for (CompiledSteps::members_t::const_iterator member = it->begin(); member != it->end(); ++member) {
+                macro.push_back(signature(**member));
+            }
+            m_macros.push_back(macro);
+        }
+    }
+    if (m_showProgress && (m_learnMacros || !macros.empty() || invalidated > 0)) {
+        std::cerr << "Macro steps: " << compiled.macroMembers.size() << " offered, " << learned.size() << " learned, " << invalidated << " invalidated" << std::endl;
+    }
     return chain;
 }
 
+/** Macro steps are saved as a block of lines, one per member in the order
+ * they run, each a step's signature; a blank line ends the block.
+ */
+void
+WW::Steps::Impl::loadMacros(std::istream& ist)
+{
+    macro_t macro;
+    std::string line;
+    while (std::getline(ist, line)) {
+        line = strip(line);
+        if (!line.empty() && line[0] == '#') {
+            continue;
+        }
+        if (!line.empty()) {
+            macro.push_back(line);
+        }
+        else if (!macro.empty()) {
+            m_macros.push_back(macro);
+            macro.clear();
+        }
+    }
+    if (!macro.empty()) {
+        m_macros.push_back(macro);
+    }
+}
+
+void
+WW::Steps::Impl::saveMacros(std::ostream& ost) const
+{
+    ost << "# Macro steps learned by testpass: each line is a step, as a hash of" << std::endl <<
+        "# its definition and its short description; a blank line ends a macro" << std::endl;
+    for (std::vector<macro_t>::const_iterator it = m_macros.begin(); it != m_macros.end(); ++it) {
+        ost << std::endl;
+        for (macro_t::const_iterator member = it->begin(); member != it->end(); ++member) {
+            ost << *member << std::endl;
+        }
+    }
+}
+
+/** Hub plans are saved after the key they were worked out for, each as a
+ * block of fields like those of a step, starting with its target.
+ */
+void
+WW::Steps::Impl::loadHubs(std::istream& ist)
+{
+    m_hubKey.clear();
+    m_hubPlans.clear();
+    std::string line;
+    while (std::getline(ist, line)) {
+        if (!line.empty() && line[0] == '#') {
+            continue;
+        }
+        strings_t x = split(line, ':', 2);
+        if (x.size() != 2) {
+            continue;
+        }
+        std::string key(strip(x[0]));
+        std::string value(strip(x[1]));
+        if (key == "key") {
+            m_hubKey = value;
+        }
+        else if (key == "target") {
+            m_hubPlans.push_back(SavedHubPlan());
+            m_hubPlans.back().target = value.empty() ? attributes_t() : attributes_t(value);
+        }
+        else if (m_hubPlans.empty()) {
+            continue;
+        }
+        else if (key == "state") {
+            m_hubPlans.back().state = value.empty() ? attributes_t() : attributes_t(value);
+        }
+        else if (key == "cost") {
+            m_hubPlans.back().cost = atol(value.c_str());
+        }
+        else if (key == "step") {
+            m_hubPlans.back().steps.push_back(value);
+        }
+    }
+}
+
+void
+WW::Steps::Impl::saveHubs(std::ostream& ost) const
+{
+    ost << "# Hub plans worked out by testpass: the cheapest steps from a state to a" << std::endl <<
+        "# hub target, each step as a hash of its definition and its short description" << std::endl <<
+        "key: " << m_hubKey << std::endl;
+    for (std::vector<SavedHubPlan>::const_iterator it = m_hubPlans.begin(); it != m_hubPlans.end(); ++it) {
+        ost << std::endl <<
+            "target: " << it->target << std::endl <<
+            "state: " << it->state << std::endl <<
+            "cost: " << it->cost << std::endl;
+        for (std::vector<std::string>::const_iterator step = it->steps.begin(); step != it->steps.end(); ++step) {
+            ost << "step: " << *step << std::endl;
+        }
+    }
+}
+
 void
 WW::Steps::Impl::add(const WW::Steps& steps, bool allAreRequired)
 {
@@ -591,6 +793,7 @@ WW::Steps::Impl::add(const TestStep& step)
         }
     }
     m_allSteps.push_back(step);
+    m_attributes.intern(step.operation());
 }
 
 /* Can result in multiple TestSteps, where there are multiple compound dependencies
@@ -714,6 +917,20 @@ WW::Steps::Impl::add(std::istream& str)
 ///
 ///
 
+WW::Steps::Stats::Stats()
+: components(0)
+, cacheHits(0)
+, cacheMisses(0)
+, cacheEvictions(0)
+, pruned(0)
+, deepestStack(0)
+, depthExceeded(0)
+, cyclesCut(0)
+, searchesAbandoned(0)
+, strategiesCutShort(0)
+{
+}
+
 WW::Steps::Steps()
 : m_pimpl(new Impl)
 {
@@ -756,6 +973,12 @@ WW::Steps::calculate() const
     return chain;
 }
 
+const WW::Steps::Stats&
+WW::Steps::stats() const
+{
+    return m_pimpl->stats();
+}
+
 void
 WW::Steps::add(const Steps& steps)
 {
@@ -864,6 +1087,90 @@ WW::Steps::setShowProgress(bool showProgress)
     m_pimpl->setShowProgress(showProgress);
 }
 
+void
+WW::Steps::setThreads(unsigned int threads)
+{
+    m_pimpl->setThreads(threads);
+}
+
+void
+WW::Steps::setEngine(Engine engine)
+{
+    m_pimpl->setEngine(engine);
+}
+
+void
+WW::Steps::setDepthLimit(unsigned int depth)
+{
+    m_pimpl->setDepthLimit(depth);
+}
+
+void
+WW::Steps::setExactLimit(unsigned int steps)
+{
+    m_pimpl->setExactLimit(steps);
+}
+
+void
+WW::Steps::setBeamWidth(unsigned int width)
+{
+    m_pimpl->setBeamWidth(width);
+}
+
+void
+WW::Steps::setLocalSearch(unsigned int milliseconds, unsigned int seed)
+{
+    m_pimpl->setLocalSearch(milliseconds, seed);
+}
+
+void
+WW::Steps::setPortfolio(unsigned int milliseconds)
+{
+    m_pimpl->setPortfolio(milliseconds);
+}
+
+void
+WW::Steps::setArenas(bool use)
+{
+    m_pimpl->setArenas(use);
+}
+
+void
+WW::Steps::setLearnMacros(bool learn)
+{
+    m_pimpl->setLearnMacros(learn);
+}
+
+void
+WW::Steps::loadMacros(std::istream& ist)
+{
+    m_pimpl->loadMacros(ist);
+}
+
+void
+WW::Steps::saveMacros(std::ostream& ost) const
+{
+    m_pimpl->saveMacros(ost);
+}
+
+void
+WW::Steps::setHubs(unsigned int hubs)
+{
+    m_pimpl->setHubs(hubs);
+}
+
+void
+WW::Steps::loadHubs(std::istream& ist)
+{
+    m_pimpl->loadHubs(ist);
+}
+
+void
+WW::Steps::saveHubs(std::ostream& ost) const
+{
+    m_pimpl->saveHubs(ost);
+}
+
 size_t
 WW::Steps::size() const
 {
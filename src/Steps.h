@@ -26,6 +26,28 @@ namespace WW
     public:
         typedef TestStep::value_type attributes_t;
 
+        /** How calculate() finds the steps leading from one state to another */
+        enum Engine {
+            RECURSIVE, // work back from the target through the steps providing it
+            ASTAR      // best-first search of the states reachable from the start
+        };
+
+        /** What the last calculate() did, for reporting its progress */
+        struct Stats
+        {
+            Stats();
+            size_t components; // sets of required steps sharing nothing, each ordered separately
+            unsigned long cacheHits; // of the memo of solves
+            unsigned long cacheMisses;
+            unsigned long cacheEvictions;
+            unsigned long pruned; // candidates abandoned by branch and bound
+            size_t deepestStack; // most solves in progress at once on any thread
+            unsigned long depthExceeded; // solves not run, being nested beyond the depth limit
+            unsigned long cyclesCut; // solves not run, being needed by themselves
+            unsigned long searchesAbandoned; // state space searches too large to complete
+            size_t strategiesCutShort; // stopped by the portfolio's deadline, over every component
+        };
+
     public:
         Steps();
         Steps(std::istream& ist);
@@ -44,12 +66,27 @@ namespace WW
         void addStep(std::istream& ist);
         void setState(const attributes_t& state);
         StepList calculate() const; // Generate the test pass
+        const Stats& stats() const; // of the last calculate()
         StepList requiredSteps() const;
         const TestStep* step(const std::string& short_desc) const;
         TestStep* step(const std::string& short_desc);
         const TestStep* step(const std::string& short_desc, const TestStep::value_type& state) const;
         TestStep* step(const std::string& short_desc, const TestStep::value_type& state);
         void setShowProgress(bool showProgress);
+        void setThreads(unsigned int threads); // threads used by calculate(); zero for one per core
+        void setEngine(Engine engine);
+        void setDepthLimit(unsigned int depth); // calculate() throws if a required step needs solves nested deeper than this
+        void setExactLimit(unsigned int steps); // order sets of at most this many required steps exactly, by dynamic programming; zero for none
+        void setBeamWidth(unsigned int width); // partial orders of the required steps kept while ordering them; one inserts each in turn
+        void setLocalSearch(unsigned int milliseconds, unsigned int seed); // improve each order of the required steps by local search for up to this long; zero for none
+        void setPortfolio(unsigned int milliseconds); // try every way of ordering the required steps at once, taking the cheapest; each stops with the best it has once this long has passed, checked between steps rather than within a solve, and the outcome can then vary from run to run
+        void setArenas(bool use); // take the solver's temporaries from arenas, one per thread, released as calculate() returns; on by default
+        void setLearnMacros(bool learn); // promote sub-plans which recur during calculate() to macro steps
+        void loadMacros(std::istream& ist); // macro steps learned before; any with a changed member is dropped
+        void saveMacros(std::ostream& ost) const;
+        void setHubs(unsigned int hubs); // precompute the cheapest plans between this many hub states; zero for none
+        void loadHubs(std::istream& ist); // hub plans computed before; only used if the steps and start are unchanged
+        void saveHubs(std::ostream& ost) const;
         size_t size() const;
         const TestStep& front() const;
         TestStep& front();
@@ -0,0 +1,221 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "ThreadPool.h"
+
+namespace {
+    // The pool, and the worker within it, which the current thread belongs to
+    thread_local const WW::ThreadPool* t_pool = 0;
+    thread_local unsigned int t_worker = 0;
+}
+
+WW::ThreadPool::TaskGroup::TaskGroup(ThreadPool& pool)
+: m_pool(pool)
+, m_pending(0)
+, m_mutex()
+, m_error()
+{
+}
+
+WW::ThreadPool::TaskGroup::~TaskGroup()
+{
+    try {
+        wait();
+    }
+    catch (...) {
+    }
+}
+
+void
+WW::ThreadPool::TaskGroup::fork(const job_t& job)
+{
+    ++m_pending;
+    Task* task = new Task(job, *this);
+    if (m_pool.m_threads.empty()) {
+        execute(task, 0);
+    }
+    else {
+        m_pool.push(m_pool.worker(), task);
+    }
+}
+
+void
+WW::ThreadPool::TaskGroup::wait()
+{
+    unsigned int worker = m_pool.worker();
+    while (m_pending != 0) {
+        if (!m_pool.runOne(worker)) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_error) {
+        std::exception_ptr error = m_error;
+        m_error = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+}
+
+void
+WW::ThreadPool::TaskGroup::completed(std::exception_ptr error)
+{
+    if (error) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_error) {
+            m_error = error;
+        }
+    }
+    --m_pending;
+}
+
+WW::ThreadPool::ThreadPool(unsigned int workers)
+: ThreadPool(workers, job_t())
+{
+}
+
+WW::ThreadPool::ThreadPool(unsigned int workers, const job_t& start)
+: m_queues()
+, m_start(start)
+, m_threads()
+, m_queued(0)
+, m_mutex()
+, m_wake()
+, m_stop(false)
+{
+    for (unsigned int worker = 0; worker < workers || worker == 0; ++worker) {
+        m_queues.push_back(std::unique_ptr<Queue>(new Queue));
+    }
+    for (unsigned int worker = 1; worker < m_queues.size(); ++worker) {
+        m_threads.push_back(std::thread(&ThreadPool::work, this, worker));
+    }
+}
+
+WW::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (std::vector<std::thread>::iterator it = m_threads.begin(); it != m_threads.end(); ++it) {
+        it->join();
+    }
+}
+
+unsigned int
+WW::ThreadPool::defaultSize()
+{
+    unsigned int result = std::thread::hardware_concurrency();
+    return (result == 0) ? 1 : result;
+}
+
+unsigned int
+WW::ThreadPool::worker() const
+{
+    return (t_pool == this) ? t_worker : 0;
+}
+
+void
+WW::ThreadPool::run(size_t count, const task_t& task)
+{
+    TaskGroup group(*this);
+    for (size_t index = 0; index < count; ++index) {
+        group.fork([&task, index](unsigned int worker) { task(index, worker); });
+    }
+    group.wait();
+}
+
+void
+WW::ThreadPool::push(unsigned int worker, Task* task)
+{
+    ++m_queued; // before the task is visible, so the count never falls short
+    {
+        Queue& queue = *m_queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    m_wake.notify_one();
+}
+
+WW::ThreadPool::Task*
+WW::ThreadPool::pop(unsigned int worker)
+{
+    {
+        Queue& queue = *m_queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            Task* task = queue.tasks.back();
+            queue.tasks.pop_back();
+            --m_queued;
+            return task;
+        }
+    }
+    for (size_t i = 1; i < m_queues.size(); ++i) {
+        Queue& victim = *m_queues[(worker + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            Task* task = victim.tasks.front();
+            victim.tasks.pop_front();
+            --m_queued;
+            return task;
+        }
+    }
+    return 0;
+}
+
+bool
+WW::ThreadPool::runOne(unsigned int worker)
+{
+    if (m_queued == 0) {
+        return false;
+    }
+    Task* task = pop(worker);
+    if (task == 0) {
+        return false;
+    }
+    execute(task, worker);
+    return true;
+}
+
+void
+WW::ThreadPool::execute(Task* task, unsigned int worker)
+{
+    std::exception_ptr error;
+    try {
+        task->job(worker);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    TaskGroup& group = task->group;
+    delete task;
+    group.completed(error);
+}
+
+void
+WW::ThreadPool::work(unsigned int worker)
+{
+    t_pool = this;
+    t_worker = worker;
+    if (m_start) {
+        m_start(worker);
+    }
+    for (;;) {
+        if (runOne(worker)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stop && m_queued == 0) {
+            m_wake.wait(lock);
+        }
+        if (m_stop) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,133 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_THREADPOOL_HEADER
+#define INCLUDE_WW_THREADPOOL_HEADER
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace WW
+{
+    /** A fixed set of worker threads which share work by stealing.
+     *
+     * Every worker has its own queue of tasks.  A worker takes the most
+     * recently forked task from its own queue, and when that is empty steals
+     * the oldest task from another worker's queue.  A thread waiting for a
+     * TaskGroup to complete runs queued tasks meanwhile, so tasks may
+     * themselves fork and wait for further tasks without deadlock.
+     *
+     * The thread which uses the pool takes part as worker zero, so a pool of
+     * size one runs everything on the calling thread and starts no threads;
+     * tasks are then run as soon as they are forked.  Only one thread outside
+     * the pool may use it at a time.
+     */
+    class ThreadPool
+    {
+    public:
+        typedef std::function<void(unsigned int worker)> job_t;
+        typedef std::function<void(size_t index, unsigned int worker)> task_t;
+
+        /** A set of forked tasks which can be waited for together */
+        class TaskGroup
+        {
+        public:
+            ~TaskGroup();
+            explicit TaskGroup(ThreadPool& pool);
+
+        private: // forbid copy and assignment
+            TaskGroup(const TaskGroup& copy);
+            TaskGroup& operator=(const TaskGroup& copy);
+
+        public:
+            /** Queue `job` to be run by any worker */
+            void fork(const job_t& job);
+            /** Run queued tasks until every task forked by this group has
+             * completed.  If any of them threw, the first exception is
+             * rethrown.
+             */
+            void wait();
+
+        private:
+            friend class ThreadPool;
+            void completed(std::exception_ptr error);
+
+        private:
+            ThreadPool& m_pool;
+            std::atomic<size_t> m_pending;
+            std::mutex m_mutex;
+            std::exception_ptr m_error;
+        };
+
+    public:
+        ~ThreadPool();
+        explicit ThreadPool(unsigned int workers);
+        /** A pool whose threads each call `start(worker)` before running any
+         * task, to set up what they need; the calling thread, worker zero,
+         * does not.
+         */
+        ThreadPool(unsigned int workers, const job_t& start);
+
+    private: // forbid copy and assignment
+        ThreadPool(const ThreadPool& copy);
+        ThreadPool& operator=(const ThreadPool& copy);
+
+    public:
+        unsigned int size() const { return static_cast<unsigned int>(m_queues.size()); }
+
+        /** Index of the worker running on the calling thread */
+        unsigned int worker() const;
+
+        /** Call `task(index, worker)` for every index in [0, count), returning
+         * once all have completed.  Tasks may complete in any order.  If a
+         * task throws, the first exception is rethrown here once the
+         * remaining tasks have finished.
+         */
+        void run(size_t count, const task_t& task);
+
+        /** Number of workers to use by default; one per hardware thread */
+        static unsigned int defaultSize();
+
+    private:
+        struct Task
+        {
+            Task(const job_t& job, TaskGroup& group) : job(job), group(group) {}
+            job_t job;
+            TaskGroup& group;
+        };
+
+        struct Queue
+        {
+            Queue() : mutex(), tasks() {}
+            std::mutex mutex;
+            std::deque<Task*> tasks;
+        };
+
+    private:
+        void work(unsigned int worker);
+        void push(unsigned int worker, Task* task);
+        Task* pop(unsigned int worker);
+        bool runOne(unsigned int worker);
+        static void execute(Task* task, unsigned int worker);
+
+    private:
+        std::vector<std::unique_ptr<Queue> > m_queues;
+        job_t m_start; // or empty
+        std::vector<std::thread> m_threads;
+        std::atomic<size_t> m_queued;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        bool m_stop;
+    };
+}
+
+#endif // INCLUDE_WW_THREADPOOL_HEADER
@@ -0,0 +1,334 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_ATTRIBUTEID_HEADER
+#define INCLUDE_WW_ATTRIBUTEID_HEADER
+
+#include "Arena.h"
+#include "attributes.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace WW
+{
+    /** An interned attribute.
+     *
+     * The key and the compound value are interned separately (see
+     * AttributeTable), so `key=value` and `key=other` share a key id and are
+     * mutually exclusive exactly as the string form is.  A value id of
+     * NO_VALUE means the attribute is not compound.
+     */
+    class AttributeId
+    {
+    public:
+        typedef unsigned int id_t;
+        typedef size_t size_type;
+        static const id_t NO_VALUE = 0;
+
+    public:
+        AttributeId() : m_key(0), m_value(NO_VALUE), m_forbidden(false) {}
+        AttributeId(id_t key, id_t value, bool forbidden) : m_key(key), m_value(value), m_forbidden(forbidden) {}
+
+    public:
+        bool operator==(const AttributeId& rhs) const { return m_key == rhs.m_key && m_value == rhs.m_value && m_forbidden == rhs.m_forbidden; }
+        bool operator!=(const AttributeId& rhs) const { return !(*this == rhs); }
+        /** Equivalent to comparing Attribute::value(); ignores the forbidden flag */
+        bool sameValue(const AttributeId& rhs) const { return m_key == rhs.m_key && m_value == rhs.m_value; }
+
+    public:
+        id_t key() const { return m_key; }
+        id_t compoundValue() const { return m_value; }
+        bool isForbidden() const { return m_forbidden; }
+        bool isCompound() const { return m_value != NO_VALUE; }
+        AttributeId forbidden(bool value) const { return AttributeId(m_key, m_value, value); }
+
+    private:
+        id_t m_key;
+        id_t m_value;
+        bool m_forbidden;
+    };
+
+    template <class Stream>
+        Stream& operator<<(Stream& str, const AttributeId& attr)
+        {
+            if (attr.isForbidden()) {
+                str << "!";
+            }
+            str << "#" << attr.key();
+            if (attr.isCompound()) {
+                str << "=#" << attr.compoundValue();
+            }
+            return str;
+        }
+
+    /** Attributes over interned ids, held in a flat array sorted by key.
+     *
+     * This mirrors the semantics of the string based Attributes, including
+     * compound exclusivity, but copies are a single allocation and comparisons
+     * are integer comparisons.  Use AttributeTable to convert to and from the
+     * string form for parsing and printing.
+     *
+     * The solver copies these freely, so their memory comes from the calling
+     * thread's current Arena, if it has one.
+     */
+    template <>
+        class Attributes<AttributeId>
+        {
+        public:
+            typedef AttributeId value_type;
+            typedef AttributeId::size_type size_type;
+            typedef AttributeId::id_t id_t;
+            typedef std::vector<value_type, ArenaAllocator<value_type> > container_t;
+            typedef const value_type& reference;
+            typedef const value_type* pointer;
+            typedef container_t::const_iterator const_iterator;
+            typedef container_t::const_iterator iterator;
+            typedef container_t::const_reverse_iterator const_reverse_iterator;
+            typedef container_t::const_reverse_iterator reverse_iterator;
+
+            /** An attribute displaced by a change, so that undo() can restore it */
+            struct Displaced
+            {
+                id_t key;
+                bool present; // otherwise the change added the key
+                value_type previous;
+            };
+            typedef std::vector<Displaced, ArenaAllocator<Displaced> > journal_t;
+
+        private:
+            container_t m_contents;
+
+            struct keyLess {
+                bool operator()(const value_type& lhs, id_t rhs) const { return lhs.key() < rhs; }
+            };
+
+            container_t::iterator lookup(id_t key) { return std::lower_bound(m_contents.begin(), m_contents.end(), key, keyLess()); }
+            const_iterator lookup(id_t key) const { return std::lower_bound(m_contents.begin(), m_contents.end(), key, keyLess()); }
+
+        public: // construction
+            ~Attributes() {}
+            Attributes() : m_contents() {}
+            explicit Attributes(const value_type& element) : m_contents(1, element) {}
+            Attributes(const Attributes& copy) : m_contents(copy.m_contents) {}
+            Attributes& operator=(const Attributes& copy) { m_contents = copy.m_contents; return *this; }
+            Attributes(Attributes&& copy) : m_contents(std::move(copy.m_contents)) {}
+            Attributes& operator=(Attributes&& copy) { m_contents.swap(copy.m_contents); return *this; }
+
+        public: // iterators
+            const_iterator begin() const { return m_contents.begin(); }
+            const_iterator end() const { return m_contents.end(); }
+            const_reverse_iterator rbegin() const { return m_contents.rbegin(); }
+            const_reverse_iterator rend() const { return m_contents.rend(); }
+            const_iterator cbegin() const { return m_contents.cbegin(); }
+            const_iterator cend() const { return m_contents.cend(); }
+
+        public:
+            bool empty() const { return m_contents.empty(); }
+            size_type size() const { return m_contents.size(); }
+            void reserve(size_type count) { m_contents.reserve(count); }
+            void clear() { m_contents.clear(); }
+
+            /** Insert or replace the attribute with the same key */
+            void insert(const value_type& val) {
+                container_t::iterator it = lookup(val.key());
+                if (it != m_contents.end() && it->key() == val.key()) {
+                    *it = val;
+                }
+                else {
+                    m_contents.insert(it, val);
+                }
+            }
+            template <class InputIterator>
+                void insert(InputIterator first, InputIterator last) {
+                    while (first != last) {
+                        insert(*first);
+                        ++first;
+                    }
+                }
+            size_type erase(id_t key) {
+                container_t::iterator it = lookup(key);
+                if (it != m_contents.end() && it->key() == key) {
+                    m_contents.erase(it);
+                    return 1;
+                }
+                return 0;
+            }
+            const_iterator find(id_t key) const {
+                const_iterator it = lookup(key);
+                return (it != m_contents.end() && it->key() == key) ? it : m_contents.end();
+            }
+            template <class _Type>
+                void applyChanges(const _Type& collection) {
+                    const_iterator end = collection.end();
+                    for (const_iterator it = collection.begin(); it != end; ++it) {
+                        if (it->isForbidden()) {
+                            erase(it->key());
+                        }
+                        else {
+                            insert(*it);
+                        }
+                    }
+                }
+
+            /** As applyChanges(), adding what each change displaced to
+             * `journal`, so that the changes can be undone in time
+             * proportional to their number rather than to the size of the
+             * set.  Changes which leave the set as it was are not recorded.
+             */
+            template <class _Type>
+                void applyChanges(const _Type& collection, journal_t& journal) {
+                    const_iterator end = collection.end();
+                    for (const_iterator it = collection.begin(); it != end; ++it) {
+                        container_t::iterator match = lookup(it->key());
+                        const bool present = match != m_contents.end() && match->key() == it->key();
+                        if (it->isForbidden() ? !present : (present && *match == *it)) {
+                            continue;
+                        }
+                        Displaced displaced = { it->key(), present, present ? *match : value_type() };
+                        journal.push_back(displaced);
+                        if (it->isForbidden()) {
+                            m_contents.erase(match);
+                        }
+                        else if (present) {
+                            *match = *it;
+                        }
+                        else {
+                            m_contents.insert(match, *it);
+                        }
+                    }
+                }
+            /** Undo the changes recorded in `journal` since it held `mark`
+             * entries, latest first, and forget them
+             */
+            void undo(journal_t& journal, size_t mark = 0) {
+                while (journal.size() > mark) {
+                    const Displaced& displaced = journal.back();
+                    if (displaced.present) {
+                        insert(displaced.previous);
+                    }
+                    else {
+                        erase(displaced.key);
+                    }
+                    journal.pop_back();
+                }
+            }
+
+            bool operator==(const Attributes& rhs) const { return m_contents == rhs.m_contents; }
+            bool operator!=(const Attributes& rhs) const { return !(*this == rhs); }
+
+            size_t hash() const {
+                size_t result = m_contents.size();
+                for (const_iterator it = begin(); it != end(); ++it) {
+                    size_t h = (static_cast<size_t>(it->key()) << 1 | (it->isForbidden() ? 1 : 0)) * 0x9e3779b1u + it->compoundValue();
+                    result ^= h + 0x9e3779b9 + (result << 6) + (result >> 2);
+                }
+                return result;
+            }
+
+            bool containsAll(const Attributes& needle) const {
+                const_iterator notfound = end();
+                for (const_iterator it = needle.begin(); it != needle.end(); ++it) {
+                    const_iterator match = find(it->key());
+                    if (match == notfound || !match->sameValue(*it)) {
+                        if (!it->isForbidden()) {
+                            return false;
+                        }
+                    }
+                    else if (it->isForbidden() != match->isForbidden()) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            bool containsAny(const Attributes& needle) const {
+                bool result = false;
+                const_iterator notfound = end();
+                for (const_iterator it = needle.begin(); it != needle.end(); ++it) {
+                    const_iterator match = find(it->key());
+                    if (match != notfound && match->sameValue(*it)) {
+                        if (it->isForbidden() != match->isForbidden()) {
+                            return false;
+                        }
+                        result = true;
+                    }
+                }
+                return result;
+            }
+
+            static void find_changes(const Attributes& state, const Attributes& target, Attributes& out_result)
+            {
+                out_result.clear();
+                const_iterator notfound = state.end();
+                for (const_iterator t_it = target.begin(); t_it != target.end(); ++t_it) {
+                    bool forbidden = t_it->isForbidden();
+                    const_iterator match = state.find(t_it->key());
+                    if (match == notfound) {
+                        if (!forbidden) {
+                            out_result.insert(*t_it);
+                        }
+                    }
+                    else if (!match->sameValue(*t_it)) { // compound
+                        if (!forbidden) {
+                            if (!match->isForbidden()) {
+                                out_result.insert(*t_it);
+                            }
+                        }
+                        else if (!t_it->isCompound()) {
+                            out_result.insert(match->forbidden(true));
+                        }
+                    }
+                    else if (forbidden) {
+                        out_result.insert(*t_it);
+                    }
+                }
+            }
+
+            static Attributes find_changes(const Attributes& state, const Attributes& target)
+            {
+                Attributes result;
+                find_changes(state, target, result);
+                return result;
+            }
+
+            Attributes differences(const Attributes& attributes) const
+            {
+                Attributes result;
+                return differences(attributes, result);
+            }
+            Attributes& differences(const Attributes& state, Attributes& out_result) const
+            {
+                out_result.clear();
+                const_iterator notfound = end();
+                for (const_iterator it = state.begin(); it != state.end(); ++it) {
+                    bool forbidden = it->isForbidden();
+                    const_iterator match = find(it->key());
+                    if (match == notfound) {
+                        if (!forbidden) {
+                            out_result.insert(*it);
+                        }
+                    }
+                    else if (!match->sameValue(*it)) { // compound
+                        if (!forbidden) {
+                            if (!match->isForbidden()) {
+                                out_result.insert(match->forbidden(true));
+                                out_result.insert(*it);
+                            }
+                        }
+                        else if (!it->isCompound()) {
+                            out_result.insert(match->forbidden(true));
+                        }
+                    }
+                    else if (forbidden) {
+                        out_result.insert(*it);
+                    }
+                }
+                return out_result;
+            }
+        };
+}
+
+#endif // INCLUDE_WW_ATTRIBUTEID_HEADER
@@ -9,6 +9,7 @@
 #include "attribute.h"
 #include "utils.h"
 
+#include <functional>
 #include <set>
 
 namespace WW
@@ -132,6 +133,17 @@ namespace WW
                 }
                 return result;
             }
+            /** Order-dependent hash of the contents; equal sets always hash equally */
+            size_t hash() const {
+                std::hash<_T> hasher;
+                size_t result = m_contents.size();
+                const_iterator e = end();
+                for (const_iterator it = begin(); it != e; ++it) {
+                    size_t h = hasher(it->value()) ^ (it->isForbidden() ? static_cast<size_t>(0x9e3779b97f4a7c15ULL) : 0);
+                    result ^= h + 0x9e3779b9 + (result << 6) + (result >> 2);
+                }
+                return result;
+            }
             bool containsAll(const Attributes& needle) const {
                 bool result = true;
                 const_iterator needleEnd = needle.end();
@@ -0,0 +1,50 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#ifndef INCLUDE_WW_BENCH_HEADER
+#define INCLUDE_WW_BENCH_HEADER
+
+#include "utils.h"
+
+#include <string>
+
+namespace WW
+{
+    class Steps;
+}
+
+namespace Bench
+{
+    /** Wall clock time in seconds */
+    double now();
+
+    struct CatalogOptions
+    {
+        CatalogOptions() : steps(100), attributes(16), required(20), compoundValues(3), seed(1) {}
+        unsigned int steps;          // steps which are neither setters nor clearers
+        unsigned int attributes;     // at least two
+        unsigned int required;       // how many of `steps` are required
+        unsigned int compoundValues; // values for the single compound key
+        unsigned int seed;
+    };
+
+    /** Generate the text of a synthetic step catalog.
+     *
+     * Every attribute has an unconditional step to set it and another to clear
+     * it.  The remaining steps only change attributes which sort after their
+     * own dependencies, so the catalog is always solvable without cycles.
+     */
+    WW::strings_t syntheticCatalog(const CatalogOptions& options);
+    void loadCatalog(const WW::strings_t& catalog, WW::Steps& out_steps);
+    /** Load every step file beneath `path`, as testpass does */
+    void loadDirectory(const std::string& path, WW::Steps& out_steps);
+
+    // Individual benchmarks
+    void stepTable();
+    void solver();
+    void allocations();
+}
+
+#endif // INCLUDE_WW_BENCH_HEADER
@@ -0,0 +1,93 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "Bench.h"
+
+#include "Steps.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+namespace {
+    std::atomic<unsigned long> allocations(0);
+}
+
+// Every allocation the program makes is counted, so calculate() can be
+// measured by the difference either side of it
+void*
+operator new(std::size_t size)
+{
+    ++allocations;
+    void* result = std::malloc(size == 0 ? 1 : size);
+    if (result == 0) {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+void
+operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void
+operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+namespace {
+    /** Count the allocations made by calculate() on a freshly loaded
+     * catalog, with the solver's temporaries in arenas or on the heap
+     */
+    void
+        measure(const std::string& name, const WW::strings_t& catalog, WW::Steps::Engine engine, const char* engineName, bool arenas)
+        {
+            WW::Steps steps;
+            Bench::loadCatalog(catalog, steps);
+            steps.setShowProgress(false);
+            steps.setThreads(1);
+            steps.setEngine(engine);
+            steps.setArenas(arenas);
+
+            const unsigned long before = allocations;
+            double start = Bench::now();
+            WW::StepList plan = steps.calculate();
+            double elapsed = Bench::now() - start;
+            const unsigned long made = allocations - before;
+
+            std::cout << std::setw(24) << std::left << name << std::right << std::setw(10) << engineName << std::setw(8) << (arenas ? "arenas" : "heap") << ": " <<
+                std::fixed << std::setprecision(3) << elapsed << "s, " <<
+                std::setw(10) << made << " allocations, " << std::setw(4) << plan.size() << " steps" << std::endl;
+        }
+}
+
+void
+Bench::allocations()
+{
+    const unsigned int sizes[][3] = { // attributes, steps, required
+        { 16, 60, 20 },
+        { 24, 120, 50 },
+        { 30, 300, 150 },
+    };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        CatalogOptions options;
+        options.attributes = sizes[i][0];
+        options.steps = sizes[i][1];
+        options.required = sizes[i][2];
+        std::ostringstream name;
+        name << options.steps << " steps, " << options.attributes << " attrs";
+        const WW::strings_t catalog = syntheticCatalog(options);
+        for (int arenas = 1; arenas >= 0; --arenas) {
+            measure(name.str(), catalog, WW::Steps::RECURSIVE, "recursive", arenas != 0);
+            measure(name.str(), catalog, WW::Steps::ASTAR, "astar", arenas != 0);
+        }
+    }
+}
@@ -0,0 +1,138 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "Bench.h"
+
+#include "Steps.h"
+
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include <dirent.h>
+#include <sys/time.h>
+
+namespace {
+    struct Benchmark {
+        const char* name;
+        void (*run)();
+    };
+
+    const Benchmark benchmarks[] = {
+        { "steptable", Bench::stepTable },
+        { "solver", Bench::solver },
+        { "allocations", Bench::allocations },
+    };
+    const size_t benchmarkCount = sizeof(benchmarks) / sizeof(benchmarks[0]);
+}
+
+double
+Bench::now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+WW::strings_t
+Bench::syntheticCatalog(const CatalogOptions& options)
+{
+    std::mt19937 random(options.seed);
+    std::uniform_int_distribution<unsigned int> cost(1, 5);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    WW::strings_t result;
+
+    for (unsigned int a = 0; a < options.attributes; ++a) {
+        std::ostringstream set;
+        set << "short: seta" << a << "\nchanges: a" << a << "\ncost: " << cost(random) << "\nrequired: no\n";
+        result.push_back(set.str());
+        std::ostringstream clear;
+        clear << "short: clra" << a << "\nchanges: !a" << a << "\ncost: " << cost(random) << "\nrequired: no\n";
+        result.push_back(clear.str());
+    }
+    for (unsigned int v = 0; v < options.compoundValues; ++v) {
+        std::ostringstream set;
+        set << "short: setk" << v << "\ndependencies: a0\nchanges: k=" << v << "\ncost: " << cost(random) << "\nrequired: no\n";
+        result.push_back(set.str());
+    }
+    for (unsigned int s = 0; s < options.steps; ++s) {
+        unsigned int split = 1 + random() % (options.attributes - 1);
+        std::ostringstream dependencies;
+        unsigned int deps = random() % 4;
+        for (unsigned int d = 0; d < deps; ++d) {
+            dependencies << (d ? "," : "") << (chance(random) < 0.3 ? "!" : "") << "a" << random() % split;
+        }
+        if (options.compoundValues > 0 && chance(random) < 0.3) {
+            dependencies << (deps ? "," : "") << "k=" << random() % options.compoundValues;
+        }
+        std::ostringstream changes;
+        unsigned int count = (s < options.required ? 0 : 1) + random() % 2;
+        for (unsigned int c = 0; c < count; ++c) {
+            changes << (c ? "," : "") << (chance(random) < 0.4 ? "!" : "") << "a" << split + random() % (options.attributes - split);
+        }
+
+        std::ostringstream step;
+        step << "short: s" << s << "\n";
+        if (!dependencies.str().empty()) {
+            step << "dependencies: " << dependencies.str() << "\n";
+        }
+        if (!changes.str().empty()) {
+            step << "changes: " << changes.str() << "\n";
+        }
+        step << "cost: " << cost(random) << "\nrequired: " << (s < options.required ? "yes" : "no") << "\n";
+        result.push_back(step.str());
+    }
+    return result;
+}
+
+void
+Bench::loadCatalog(const WW::strings_t& catalog, WW::Steps& out_steps)
+{
+    for (WW::strings_t::const_iterator it = catalog.begin(); it != catalog.end(); ++it) {
+        out_steps.addStep(*it);
+    }
+}
+
+void
+Bench::loadDirectory(const std::string& path, WW::Steps& out_steps)
+{
+    DIR* dir = opendir(path.c_str());
+    if (dir == 0) {
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != 0) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::string name = path + "/" + entry->d_name;
+        if (entry->d_type == DT_DIR) {
+            loadDirectory(name, out_steps);
+        }
+        else {
+            std::ifstream ist(name.c_str());
+            if (ist.good()) {
+                out_steps.addStep(ist);
+            }
+        }
+    }
+    closedir(dir);
+}
+
+int main(int argc, char* argv[])
+{
+    for (size_t i = 0; i < benchmarkCount; ++i) {
+        bool selected = (argc < 2);
+        for (int arg = 1; arg < argc; ++arg) {
+            selected = selected || (benchmarks[i].name == std::string(argv[arg]));
+        }
+        if (selected) {
+            std::cout << "== " << benchmarks[i].name << std::endl;
+            benchmarks[i].run();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "Bench.h"
+
+#include "Steps.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    typedef void (*load_t)(WW::Steps& out_steps, const void* source);
+
+    void
+        loadSynthetic(WW::Steps& out_steps, const void* source)
+        {
+            Bench::loadCatalog(Bench::syntheticCatalog(*static_cast<const Bench::CatalogOptions*>(source)), out_steps);
+        }
+
+    void
+        loadPath(WW::Steps& out_steps, const void* source)
+        {
+            Bench::loadDirectory(static_cast<const char*>(source), out_steps);
+        }
+
+    /** Time calculate() with each engine on freshly loaded copies of a catalog */
+    void
+        compare(const std::string& name, load_t load, const void* source)
+        {
+            const struct { const char* name; WW::Steps::Engine engine; } engines[] = {
+                { "recursive", WW::Steps::RECURSIVE },
+                { "astar", WW::Steps::ASTAR },
+            };
+            for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e) {
+                WW::Steps steps;
+                load(steps, source);
+                if (steps.size() == 0) {
+                    std::cout << name << ": no steps" << std::endl;
+                    return;
+                }
+                steps.setShowProgress(false);
+                steps.setThreads(1);
+                steps.setEngine(engines[e].engine);
+
+                double start = Bench::now();
+                WW::StepList plan = steps.calculate();
+                double elapsed = Bench::now() - start;
+
+                unsigned long cost = 0;
+                for (WW::StepList::const_iterator it = plan.begin(); it != plan.end(); ++it) {
+                    cost += it->cost();
+                }
+                std::cout << std::setw(24) << std::left << name << std::right << std::setw(10) << engines[e].name << ": " <<
+                    std::fixed << std::setprecision(3) << elapsed << "s, " <<
+                    std::setw(4) << plan.size() << " steps costing " << cost << std::endl;
+            }
+        }
+}
+
+void
+Bench::solver()
+{
+    compare("steps/", loadPath, "steps");
+
+    const unsigned int sizes[][3] = { // attributes, steps, required
+        { 16, 60, 20 },
+        { 24, 120, 50 },
+        { 30, 300, 150 },
+    };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        CatalogOptions options;
+        options.attributes = sizes[i][0];
+        options.steps = sizes[i][1];
+        options.required = sizes[i][2];
+        std::ostringstream name;
+        name << options.steps << " steps, " << options.attributes << " attrs";
+        compare(name.str(), loadSynthetic, &options);
+    }
+}
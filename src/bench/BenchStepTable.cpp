@@ -0,0 +1,125 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include "Bench.h"
+
+#include "StepTable.h"
+#include "TestStep.h"
+
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <random>
+#include <sstream>
+
+namespace {
+    typedef WW::TestStep::attributes_t attributes_t;
+
+    attributes_t
+        randomAttributes(std::mt19937& random, unsigned int attributes, unsigned int count)
+        {
+            attributes_t result;
+            for (unsigned int i = 0; i < count; ++i) {
+                std::ostringstream ost;
+                ost << ((random() % 3 == 0) ? "!" : "") << "a" << random() % attributes;
+                result.insert(attributes_t::value_type(ost.str()));
+            }
+            return result;
+        }
+
+    void
+        compare(unsigned int steps, unsigned int attributes)
+        {
+            Bench::CatalogOptions options;
+            options.steps = steps;
+            options.attributes = attributes;
+            WW::strings_t catalog = Bench::syntheticCatalog(options);
+
+            std::list<WW::TestStep> store; // as the solver held them before the step table
+            WW::AttributeTable table;
+            std::vector<WW::AttributeTable::id_operation_t> operations;
+            for (WW::strings_t::const_iterator it = catalog.begin(); it != catalog.end(); ++it) {
+                store.push_back(WW::TestStep(*it));
+                operations.push_back(table.intern(store.back().operation()));
+            }
+
+            double start = Bench::now();
+            WW::StepTable stepTable(operations);
+            double built = Bench::now() - start;
+
+            std::mt19937 random(1);
+            const unsigned int queries = 200;
+            std::vector<attributes_t> changes;
+            std::vector<attributes_t> states;
+            for (unsigned int q = 0; q < queries; ++q) {
+                changes.push_back(randomAttributes(random, attributes, 1 + random() % 3));
+                states.push_back(randomAttributes(random, attributes, attributes / 2));
+            }
+
+            size_t listMatches = 0;
+            start = Bench::now();
+            for (unsigned int q = 0; q < queries; ++q) {
+                for (std::list<WW::TestStep>::const_iterator it = store.begin(); it != store.end(); ++it) {
+                    listMatches += it->operation().changes().containsAny(changes[q]) ? 1 : 0;
+                    listMatches += it->operation().isValid(states[q]) ? 1 : 0;
+                }
+            }
+            double listTime = Bench::now() - start;
+
+            std::vector<WW::AttributeTable::ids_t> idChanges;
+            std::vector<WW::StepTable::mask_t> masks(queries);
+            for (unsigned int q = 0; q < queries; ++q) {
+                idChanges.push_back(table.intern(changes[q]));
+                stepTable.stateMask(table.intern(states[q]), masks[q]);
+            }
+            std::vector<WW::StepTable::mask_t> adds(queries);
+            std::vector<WW::StepTable::mask_t> removes(queries);
+            for (unsigned int q = 0; q < queries; ++q) {
+                stepTable.changeMasks(idChanges[q], adds[q], removes[q]);
+            }
+            size_t tableMatches = 0;
+            WW::StepTable::indices_t result;
+            start = Bench::now();
+            for (unsigned int q = 0; q < queries; ++q) {
+                stepTable.findProviding(adds[q], removes[q], result);
+                tableMatches += result.size();
+                stepTable.findValid(masks[q], result);
+                tableMatches += result.size();
+            }
+            double tableTime = Bench::now() - start;
+
+            // Providers alone: mask scan against the inverted index
+            size_t scanMatches = 0;
+            start = Bench::now();
+            for (unsigned int q = 0; q < queries; ++q) {
+                stepTable.findProviding(adds[q], removes[q], result);
+                scanMatches += result.size();
+            }
+            double scanTime = Bench::now() - start;
+            size_t indexMatches = 0;
+            start = Bench::now();
+            for (unsigned int q = 0; q < queries; ++q) {
+                stepTable.findProviding(idChanges[q], result);
+                indexMatches += result.size();
+            }
+            double indexTime = Bench::now() - start;
+
+            std::cout << std::setw(6) << store.size() << " steps, " << std::setw(4) << attributes << " attributes: " <<
+                "list scan " << std::fixed << std::setprecision(3) << listTime * 1000 / queries << "ms/query, " <<
+                "step table " << tableTime * 1000 / queries << "ms/query (built in " << built * 1000 << "ms)" <<
+                ((listMatches == tableMatches) ? "" : " MISMATCH") << std::endl <<
+                "        providers: scan " << scanTime * 1000 / queries << "ms/query, " <<
+                "index " << indexTime * 1000 / queries << "ms/query" <<
+                ((scanMatches == indexMatches) ? "" : " MISMATCH") << std::endl;
+        }
+}
+
+void
+Bench::stepTable()
+{
+    compare(10000, 64);
+    compare(10000, 256);
+    compare(50000, 256);
+}
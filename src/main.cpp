@@ -15,6 +15,7 @@
 #include <vector>
 
 #include <dirent.h>
+#include <stdlib.h>
 #include <strings.h>
 #include <sys/types.h>
 
@@ -70,6 +71,19 @@ namespace {
             }
         }
 
+    void
+        printStats(const WW::Steps::Stats& stats, bool astar)
+        {
+            std::cerr << "Components: " << stats.components << " solved independently" << std::endl;
+            std::cerr << "Solve cache: " << stats.cacheHits << " hits, " << stats.cacheMisses << " misses, " << stats.cacheEvictions << " evictions" << std::endl;
+            std::cerr << "Branch and bound: " << stats.pruned << " candidates pruned" << std::endl;
+            std::cerr << "Solve stack: " << stats.deepestStack << " frames deep, " << stats.depthExceeded << " solves beyond the depth limit" << std::endl;
+            std::cerr << "Cycles cut: " << stats.cyclesCut << std::endl;
+            if (astar) {
+                std::cerr << "State search: " << stats.searchesAbandoned << " searches abandoned" << std::endl;
+            }
+        }
+
     void
         usage(const std::string& program_path)
         {
@@ -84,6 +98,15 @@ namespace {
             " -s CONDITIONS\tspecify the starting state" << std::endl <<
             " -r DIRECTORY\tspecify directory containing required tests" << std::endl <<
             " -i LOGFILE\tinteractive mode" << std::endl <<
+            " -j THREADS\tnumber of threads used to compile the test pass" << std::endl <<
+            " -e ENGINE\tsolver engine, 'recursive' (default) or 'astar'" << std::endl <<
+            " -d DEPTH\tlimit on the depth of nested solves" << std::endl <<
+            " -x STEPS\torder sets of at most this many required steps exactly, up to 20" << std::endl <<
+            " -b WIDTH\tpartial orders of the required steps kept while ordering them" << std::endl <<
+            " -o MS[,SEED]\timprove the order of the required steps by local search for up to MS milliseconds" << std::endl <<
+            " -p MS\t\ttry every way of ordering the required steps at once, stopping between steps after MS milliseconds" << std::endl <<
+            " -m\t\tlearn macro steps, kept in the first directory" << std::endl <<
+            " -l HUBS\tprecompute plans between this many hub states, kept in the first directory" << std::endl <<
             std::endl;
         }
 
@@ -163,6 +186,10 @@ int main(int argc, char* argv[])
     bool interactive_mode = false;
     std::string logFile;
     bool clearedRequired = false;
+    bool learnMacros = false;
+    unsigned int hubs = 0;
+    bool astar = false;
+    std::string catalog; // the first directory loaded
 
     bool loaded = false;
     WW::Steps steps;
@@ -217,6 +244,115 @@ int main(int argc, char* argv[])
                     }
                     break;
 
+                case 'j': // threads used by the solver
+                    {
+                        if (argv[arg][2] != '\0') {
+                            steps.setThreads(atoi(argv[arg] + 2));
+                        }
+                        else if (arg + 1 < argc) {
+                            steps.setThreads(atoi(argv[++arg]));
+                        }
+                    }
+                    break;
+
+                case 'd': // depth limit of the solver
+                    {
+                        if (argv[arg][2] != '\0') {
+                            steps.setDepthLimit(atoi(argv[arg] + 2));
+                        }
+                        else if (arg + 1 < argc) {
+                            steps.setDepthLimit(atoi(argv[++arg]));
+                        }
+                    }
+                    break;
+
+                case 'x': // required steps ordered exactly
+                    {
+                        if (argv[arg][2] != '\0') {
+                            steps.setExactLimit(atoi(argv[arg] + 2));
+                        }
+                        else if (arg + 1 < argc) {
+                            steps.setExactLimit(atoi(argv[++arg]));
+                        }
+                    }
+                    break;
+
+                case 'b': // beam width ordering the required steps
+                    {
+                        if (argv[arg][2] != '\0') {
+                            steps.setBeamWidth(atoi(argv[arg] + 2));
+                        }
+                        else if (arg + 1 < argc) {
+                            steps.setBeamWidth(atoi(argv[++arg]));
+                        }
+                    }
+                    break;
+
+                case 'o': // local search improving the order of the required steps
+                    {
+                        std::string search;
+                        if (argv[arg][2] != '\0') {
+                            search = argv[arg] + 2;
+                        }
+                        else if (arg + 1 < argc) {
+                            search = argv[++arg];
+                        }
+                        std::string::size_type comma = search.find(',');
+                        unsigned int seed = (comma == std::string::npos) ? 0 : atoi(search.c_str() + comma + 1);
+                        steps.setLocalSearch(atoi(search.c_str()), seed);
+                    }
+                    break;
+
+                case 'p': // portfolio of ways to order the required steps
+                    {
+                        if (argv[arg][2] != '\0') {
+                            steps.setPortfolio(atoi(argv[arg] + 2));
+                        }
+                        else if (arg + 1 < argc) {
+                            steps.setPortfolio(atoi(argv[++arg]));
+                        }
+                    }
+                    break;
+
+                case 'm': // learn macro steps
+                    learnMacros = true;
+                    break;
+
+                case 'l': // hub states whose plans are precomputed
+                    {
+                        if (argv[arg][2] != '\0') {
+                            hubs = atoi(argv[arg] + 2);
+                        }
+                        else if (arg + 1 < argc) {
+                            hubs = atoi(argv[++arg]);
+                        }
+                    }
+                    break;
+
+                case 'e': // solver engine
+                    {
+                        std::string engine;
+                        if (argv[arg][2] != '\0') {
+                            engine = argv[arg] + 2;
+                        }
+                        else if (arg + 1 < argc) {
+                            engine = argv[++arg];
+                        }
+                        if (engine == "recursive") {
+                            steps.setEngine(WW::Steps::RECURSIVE);
+                            astar = false;
+                        }
+                        else if (engine == "astar") {
+                            steps.setEngine(WW::Steps::ASTAR);
+                            astar = true;
+                        }
+                        else {
+                            usage(argv[0]);
+                            return 0;
+                        }
+                    }
+                    break;
+
                 default:
                     usage(argv[0]);
                     return 0;
@@ -226,6 +362,9 @@ int main(int argc, char* argv[])
         {
             WW::Steps items;
             addDirectory(argv[arg], items);
+            if (catalog.empty()) {
+                catalog = argv[arg];
+            }
             if (clearedRequired) {
                 WW::StepList required = items.requiredSteps();
                 for (WW::StepList::const_iterator it = required.begin(); it != required.end(); ++it) {
@@ -247,6 +386,11 @@ int main(int argc, char* argv[])
     if (!loaded) {
         addDirectory("steps", steps);
     }
+    if (catalog.empty()) {
+        catalog = "steps";
+    }
+    const std::string macroFile = catalog + "/.macros"; // not loaded as a step, being hidden
+    const std::string hubFile = catalog + "/.hubs";
 
     WW::StepList solution;
     WW::StepList requiredSteps = steps.requiredSteps();
@@ -261,6 +405,20 @@ int main(int argc, char* argv[])
     }
 
     steps.setState(state);
+    if (learnMacros) {
+        std::ifstream ist(macroFile.c_str());
+        if (ist.good()) {
+            steps.loadMacros(ist);
+        }
+        steps.setLearnMacros(true);
+    }
+    if (hubs > 0) {
+        std::ifstream ist(hubFile.c_str());
+        if (ist.good()) {
+            steps.loadHubs(ist);
+        }
+        steps.setHubs(hubs);
+    }
 
     try
     {
@@ -270,6 +428,16 @@ int main(int argc, char* argv[])
         std::cerr << "ERROR: " << e.what() << std::endl;
         return 1;
     }
+    printStats(steps.stats(), astar);
+
+    if (learnMacros) {
+        std::ofstream ost(macroFile.c_str());
+        steps.saveMacros(ost);
+    }
+    if (hubs > 0) {
+        std::ofstream ost(hubFile.c_str());
+        steps.saveHubs(ost);
+    }
 
     if (solution.size() == 0)
     {
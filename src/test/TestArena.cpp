@@ -0,0 +1,45 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include <gtest/gtest.h>
+
+#include "Arena.h"
+
+#include <vector>
+
+TEST(TestArena, ReusesBlocks)
+{
+    WW::Arena arena;
+    WW::ScopedArena scope(&arena);
+    ASSERT_EQ(&arena, WW::Arena::current());
+
+    void* first = WW::Arena::obtain(40);
+    ASSERT_LT(static_cast<size_t>(0), arena.reserved());
+    WW::Arena::release(first, 40);
+    ASSERT_EQ(first, WW::Arena::obtain(40)) << "A block given back is used for the next of its size";
+
+    size_t reserved = arena.reserved();
+    std::vector<int, WW::ArenaAllocator<int> > numbers;
+    for (int i = 0; i < 100; ++i) {
+        numbers.push_back(i);
+    }
+    ASSERT_EQ(99, numbers.back());
+    ASSERT_EQ(reserved, arena.reserved()) << "Growing a small vector fits in the first chunk";
+}
+
+TEST(TestArena, FallsBackToTheHeap)
+{
+    ASSERT_EQ(static_cast<WW::Arena*>(0), WW::Arena::current());
+    std::vector<int, WW::ArenaAllocator<int> > numbers(10, 1);
+    {
+        WW::Arena arena;
+        WW::ScopedArena scope(&arena);
+        std::vector<int, WW::ArenaAllocator<int> > large(10000, 2);
+        ASSERT_EQ(static_cast<size_t>(0), arena.reserved()) << "Large blocks come from the global allocator";
+        numbers.clear();
+        numbers.shrink_to_fit(); // allocated before the arena was current, so given back to the heap
+    }
+    ASSERT_EQ(static_cast<WW::Arena*>(0), WW::Arena::current()) << "The previous arena is restored";
+}
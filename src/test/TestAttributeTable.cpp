@@ -0,0 +1,105 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include <gtest/gtest.h>
+
+#include "AttributeTable.h"
+
+#include <sstream>
+
+typedef WW::AttributeTable::attributes_t attributes_t;
+typedef WW::AttributeTable::ids_t ids_t;
+
+TEST(TestAttributeTable, InternIsStable)
+{
+    WW::AttributeTable table;
+    WW::AttributeId one = table.intern(WW::Attribute<std::string>("one"));
+    WW::AttributeId fruit = table.intern(WW::Attribute<std::string>("fruit=apple"));
+    WW::AttributeId pear = table.intern(WW::Attribute<std::string>("!fruit=pear"));
+
+    ASSERT_EQ(one, table.intern(WW::Attribute<std::string>("one"))) << "The same string always has the same id";
+    ASSERT_FALSE(one.isCompound());
+    ASSERT_TRUE(fruit.isCompound());
+    ASSERT_EQ(fruit.key(), pear.key()) << "Compound values share their key";
+    ASSERT_NE(fruit.compoundValue(), pear.compoundValue());
+    ASSERT_TRUE(pear.isForbidden());
+    ASSERT_EQ(static_cast<size_t>(2), table.keyCount());
+    ASSERT_EQ(static_cast<size_t>(2), table.valueCount());
+
+    std::ostringstream ost;
+    ost << table.name(pear);
+    ASSERT_EQ("!fruit=pear", ost.str());
+}
+
+TEST(TestAttributeTable, RoundTrip)
+{
+    WW::AttributeTable table;
+    attributes_t attributes("one,!two,fruit=banana,!hat=trilby");
+    ids_t ids = table.intern(attributes);
+    ASSERT_EQ(attributes.size(), ids.size());
+    ASSERT_EQ(attributes, table.names(ids));
+}
+
+TEST(TestAttributeTable, CompoundExclusivity)
+{
+    WW::AttributeTable table;
+    ids_t state = table.intern(attributes_t("fruit=apple,one"));
+    state.applyChanges(table.intern(attributes_t("fruit=pear")));
+    ASSERT_EQ(attributes_t("fruit=pear,one"), table.names(state)) << "A compound value displaces the previous value";
+
+    state.applyChanges(table.intern(attributes_t("!fruit=banana")));
+    ASSERT_EQ(attributes_t("one"), table.names(state)) << "Forbidding any compound value removes the key";
+}
+
+TEST(TestAttributeTable, UndoChanges)
+{
+    WW::AttributeTable table;
+    const ids_t start = table.intern(attributes_t("fruit=apple,one,two"));
+    ids_t state = start;
+    ids_t::journal_t journal;
+    state.applyChanges(table.intern(attributes_t("fruit=pear,!one,three,!four")), journal);
+    ASSERT_EQ(attributes_t("fruit=pear,two,three"), table.names(state));
+    ASSERT_EQ(static_cast<size_t>(3), journal.size()) << "Only the changes which did something are recorded";
+
+    const size_t mark = journal.size();
+    state.applyChanges(table.intern(attributes_t("!fruit,one")), journal);
+    ASSERT_EQ(attributes_t("one,two,three"), table.names(state));
+    state.undo(journal, mark);
+    ASSERT_EQ(attributes_t("fruit=pear,two,three"), table.names(state)) << "Undone back to the mark";
+    ASSERT_EQ(mark, journal.size());
+    state.undo(journal);
+    ASSERT_EQ(start, state);
+    ASSERT_TRUE(journal.empty());
+}
+
+TEST(TestAttributeTable, MatchesStringSemantics)
+{
+    const char* sets[] = {
+        "one", "!one", "two", "one,two", "!one,two", "fruit=apple", "!fruit=apple", "fruit=pear",
+        "fruit", "!fruit", "one,fruit=apple", "!two,fruit=pear", "one,!fruit=pear,two",
+    };
+    const size_t count = sizeof(sets) / sizeof(sets[0]);
+
+    WW::AttributeTable table;
+    for (size_t s = 0; s < count; ++s) {
+        for (size_t t = 0; t < count; ++t) {
+            attributes_t state(sets[s]);
+            attributes_t target(sets[t]);
+            ids_t id_state = table.intern(state);
+            ids_t id_target = table.intern(target);
+
+            ASSERT_EQ(state.containsAll(target), id_state.containsAll(id_target)) << sets[s] << " containsAll " << sets[t];
+            ASSERT_EQ(state.containsAny(target), id_state.containsAny(id_target)) << sets[s] << " containsAny " << sets[t];
+            ASSERT_EQ(attributes_t::find_changes(state, target), table.names(ids_t::find_changes(id_state, id_target))) << sets[s] << " find_changes " << sets[t];
+            ASSERT_EQ(state.differences(target), table.names(id_state.differences(id_target))) << sets[s] << " differences " << sets[t];
+
+            attributes_t applied = state;
+            applied.applyChanges(target);
+            ids_t id_applied = id_state;
+            id_applied.applyChanges(id_target);
+            ASSERT_EQ(applied, table.names(id_applied)) << sets[s] << " applyChanges " << sets[t];
+        }
+    }
+}
@@ -0,0 +1,59 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include <gtest/gtest.h>
+
+#include "FrameStack.h"
+
+#include <vector>
+
+namespace {
+    struct Frame
+    {
+        Frame() : value(0), buffer() {}
+        void reset() { value = 0; buffer.clear(); }
+        int value;
+        std::vector<int> buffer;
+    };
+}
+
+TEST(TestFrameStack, PushAndPop)
+{
+    WW::FrameStack<Frame> stack;
+    ASSERT_TRUE(stack.empty());
+    stack.push().value = 1;
+    Frame& bottom = stack.top();
+    for (int i = 2; i <= 100; ++i) {
+        stack.push().value = i;
+    }
+    ASSERT_EQ(static_cast<size_t>(100), stack.size());
+    ASSERT_EQ(1, bottom.value) << "Frames stay where they are as others are pushed";
+    ASSERT_EQ(&bottom, &stack[0]);
+    ASSERT_EQ(100, stack.top().value);
+
+    stack.pop();
+    ASSERT_EQ(99, stack.top().value);
+    stack.popTo(1);
+    ASSERT_EQ(static_cast<size_t>(1), stack.size());
+    ASSERT_EQ(&bottom, &stack.top());
+    stack.popTo(5);
+    ASSERT_EQ(static_cast<size_t>(1), stack.size()) << "Popping to a greater size leaves the stack alone";
+}
+
+TEST(TestFrameStack, RecyclesFrames)
+{
+    WW::FrameStack<Frame> stack;
+    Frame& first = stack.push();
+    first.value = 7;
+    first.buffer.assign(64, 7);
+    stack.pop();
+
+    Frame& second = stack.push();
+    ASSERT_EQ(&first, &second);
+    ASSERT_EQ(0, second.value) << "A recycled frame is reset";
+    ASSERT_TRUE(second.buffer.empty());
+    ASSERT_LE(static_cast<size_t>(64), second.buffer.capacity()) << "but keeps its memory";
+    ASSERT_EQ(static_cast<size_t>(1), stack.allocated());
+}
@@ -0,0 +1,88 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include <gtest/gtest.h>
+
+#include "Plan.h"
+
+#include <string>
+
+namespace {
+    std::string
+        names(const WW::Plan& plan)
+        {
+            WW::StepList steps;
+            plan.appendTo(steps);
+            std::string result;
+            for (WW::StepList::const_iterator it = steps.begin(); it != steps.end(); ++it) {
+                result += it->short_desc();
+            }
+            return result;
+        }
+}
+
+TEST(TestPlan, JoinSharesStructure)
+{
+    WW::TestStep steps[4];
+    const char* letters[] = { "a", "b", "c", "d" };
+    for (size_t i = 0; i < 4; ++i) {
+        steps[i].short_desc(letters[i]);
+    }
+    WW::PlanArena arena;
+    WW::Plan empty;
+    ASSERT_TRUE(empty.empty());
+    ASSERT_EQ("", names(empty));
+
+    WW::Plan ab = arena.join(arena.step(steps[0]), arena.step(steps[1]));
+    WW::Plan abc = arena.join(ab, arena.step(steps[2]));
+    WW::Plan abd = arena.join(ab, arena.step(steps[3]));
+    ASSERT_EQ(static_cast<size_t>(3), abc.size());
+    ASSERT_EQ("abc", names(abc));
+    ASSERT_EQ("abd", names(abd)) << "Extending a plan leaves it as it was";
+    ASSERT_EQ("ab", names(ab));
+    ASSERT_EQ(ab.root(), arena.join(ab, empty).root()) << "Joining nothing makes no node";
+    ASSERT_EQ("abcabd", names(arena.join(abc, abd)));
+
+    WW::StepList list;
+    list.push_back(steps[3]);
+    list.push_back(steps[2]);
+    list.push_back(steps[1]);
+    ASSERT_EQ("dcb", names(arena.copy(list)));
+}
+
+TEST(TestPlan, DeepPlans)
+{
+    WW::TestStep step;
+    step.short_desc("x");
+    WW::PlanArena arena;
+    WW::Plan plan;
+    for (size_t i = 0; i < 10000; ++i) {
+        plan = arena.join(plan, arena.step(step));
+    }
+    ASSERT_EQ(static_cast<size_t>(10000), plan.size());
+    size_t count = 0;
+    plan.forEach([&count](const WW::TestStep&) { ++count; });
+    ASSERT_EQ(static_cast<size_t>(10000), count) << "Nesting deeper than the local stack is visited in full";
+}
+
+TEST(TestPlan, MarkAndRelease)
+{
+    WW::TestStep step;
+    WW::PlanArena arena;
+    ASSERT_EQ(static_cast<size_t>(0), arena.memoryUsed());
+    arena.step(step);
+    size_t used = arena.memoryUsed();
+    ASSERT_LT(static_cast<size_t>(0), used);
+
+    WW::PlanArena::Mark mark = arena.mark();
+    for (size_t i = 0; i < 10000; ++i) {
+        arena.step(step);
+    }
+    ASSERT_LT(used, arena.memoryUsed());
+    arena.release(mark);
+    ASSERT_EQ(used, arena.memoryUsed());
+    arena.reset();
+    ASSERT_EQ(static_cast<size_t>(0), arena.memoryUsed());
+}
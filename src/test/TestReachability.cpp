@@ -0,0 +1,70 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include <gtest/gtest.h>
+
+#include "Reachability.h"
+
+typedef WW::AttributeTable::attributes_t attributes_t;
+typedef WW::AttributeTable::ids_t ids_t;
+
+namespace {
+    WW::AttributeTable::id_operation_t
+        makeOperation(WW::AttributeTable& table, const char* dependencies, const char* changes)
+        {
+            WW::AttributeTable::operation_t operation;
+            if (dependencies[0] != '\0') {
+                operation.dependencies(attributes_t(dependencies));
+            }
+            if (changes[0] != '\0') {
+                operation.changes(attributes_t(changes));
+            }
+            return table.intern(operation);
+        }
+}
+
+TEST(TestReachability, FindsRunnableOperations)
+{
+    WW::AttributeTable table;
+    std::vector<WW::AttributeTable::id_operation_t> ops;
+    ops.push_back(makeOperation(table, "installed", "!installed"));  // 0: from the start
+    ops.push_back(makeOperation(table, "!installed", "eicar"));      // 1: once 0 has run
+    ops.push_back(makeOperation(table, "eicar,installed", "found")); // 2: relaxed, both can hold
+    ops.push_back(makeOperation(table, "licensed", "found"));        // 3: nothing gives 'licensed'
+    ops.push_back(makeOperation(table, "found", "fruit=apple"));     // 4: once 2 has run
+    ops.push_back(makeOperation(table, "fruit=pear", "pie"));        // 5: only apples are given
+    ops.push_back(makeOperation(table, "!fruit=apple", "crumble"));  // 6: the start has no fruit
+    ops.push_back(makeOperation(table, "!zero", "one"));             // 7: 'zero' is never given
+
+    WW::Reachability reachable(table.intern(attributes_t("installed")), ops);
+    bool expected[] = { true, true, true, false, true, false, true, true };
+    for (size_t i = 0; i < ops.size(); ++i) {
+        ASSERT_EQ(expected[i], reachable.canRun(i)) << "operation " << i;
+    }
+    ASSERT_EQ(static_cast<size_t>(6), reachable.runnableCount());
+
+    ids_t missing;
+    reachable.findUnreachable(ops[5].dependencies(), missing);
+    ASSERT_EQ(attributes_t("fruit=pear"), table.names(missing));
+    reachable.findUnreachable(ops[2].dependencies(), missing);
+    ASSERT_TRUE(missing.empty());
+}
+
+TEST(TestReachability, ForbiddenCompoundNeedsAnotherValue)
+{
+    WW::AttributeTable table;
+    std::vector<WW::AttributeTable::id_operation_t> ops;
+    ops.push_back(makeOperation(table, "!fruit=apple", "pie"));
+    ops.push_back(makeOperation(table, "pie", "fruit=pear"));
+
+    WW::Reachability stuck(table.intern(attributes_t("fruit=apple")), ops);
+    ASSERT_FALSE(stuck.canRun(0)) << "Nothing takes the apple away";
+    ASSERT_FALSE(stuck.canRun(1));
+
+    ops.push_back(makeOperation(table, "", "fruit=plum"));
+    WW::Reachability swapped(table.intern(attributes_t("fruit=apple")), ops);
+    ASSERT_TRUE(swapped.canRun(0)) << "A plum instead of an apple will do";
+    ASSERT_TRUE(swapped.canRun(1));
+}
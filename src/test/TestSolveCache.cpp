@@ -0,0 +1,52 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include <gtest/gtest.h>
+
+#include "SolveCache.h"
+#include "TestStep.h"
+
+typedef WW::SolveCache<WW::TestStep::attributes_t> cache_t;
+
+TEST(TestSolveCache, FindReturnsInsertedSolution)
+{
+    typedef cache_t::attributes_t attributes_t;
+    cache_t cache;
+    WW::TestStep step;
+    step.short_desc("setup");
+    WW::StepList solution;
+    solution.push_back(step);
+
+    int cost = 0;
+    WW::StepList result;
+    ASSERT_FALSE(cache.find(attributes_t("one"), attributes_t("two"), cost, result));
+    ASSERT_EQ(static_cast<unsigned long>(1), cache.stats().misses);
+
+    cache.insert(attributes_t("one"), attributes_t("two"), 3, solution);
+    ASSERT_TRUE(cache.find(attributes_t("one"), attributes_t("two"), cost, result));
+    ASSERT_EQ(3, cost);
+    ASSERT_EQ(static_cast<size_t>(1), result.size());
+    ASSERT_EQ("setup", result.begin()->short_desc());
+    ASSERT_EQ(static_cast<unsigned long>(1), cache.stats().hits);
+
+    ASSERT_FALSE(cache.find(attributes_t("one"), attributes_t("!two"), cost, result)) << "Forbidden attributes are distinct keys";
+    ASSERT_FALSE(cache.find(attributes_t("two"), attributes_t("one"), cost, result)) << "State and target are not interchangeable";
+}
+
+TEST(TestSolveCache, MemoryLimit)
+{
+    typedef cache_t::attributes_t attributes_t;
+    cache_t cache(1024);
+    WW::StepList solution;
+
+    std::string name = "a";
+    for (int i = 0; i < 100; ++i) {
+        name += "a";
+        cache.insert(attributes_t(name), attributes_t("target"), i, solution);
+        ASSERT_LE(cache.memoryUsed(), cache.memoryLimit());
+    }
+    ASSERT_LT(cache.size(), static_cast<size_t>(100));
+    ASSERT_GT(cache.stats().evictions, static_cast<unsigned long>(0));
+}
@@ -0,0 +1,92 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include <gtest/gtest.h>
+
+#include "AttributeTable.h"
+#include "StateTable.h"
+
+namespace {
+    WW::AttributeTable::ids_t
+        parse(WW::AttributeTable& table, const char* text)
+        {
+            return table.intern(WW::AttributeTable::attributes_t(text));
+        }
+}
+
+TEST(TestStateTable, InternsEachStateOnce)
+{
+    WW::AttributeTable names;
+    WW::StateTable table;
+    WW::StateId a = table.intern(parse(names, "a, b, colour=red"));
+    WW::StateId b = table.intern(parse(names, "colour=red, b, a"));
+    WW::StateId c = table.intern(parse(names, "a, b, colour=blue"));
+    ASSERT_EQ(a, b);
+    ASSERT_EQ(a.hash(), b.hash());
+    ASSERT_NE(a, c);
+    ASSERT_EQ(static_cast<size_t>(2), table.size());
+    ASSERT_EQ(parse(names, "a, b, colour=blue"), table.attributes(c));
+    ASSERT_FALSE(WW::StateId().valid());
+    ASSERT_TRUE(a.valid());
+}
+
+TEST(TestStateTable, ApplyMatchesIntern)
+{
+    WW::AttributeTable names;
+    WW::StateTable table;
+    WW::StateId start = table.intern(parse(names, "a, b, colour=red"));
+    WW::AttributeTable::ids_t changes = parse(names, "!a, c, colour=blue");
+    WW::StateId next = table.apply(start, changes);
+    WW::StateId expected = table.intern(parse(names, "b, c, colour=blue"));
+    ASSERT_EQ(expected, next) << "Removing, adding and replacing an attribute reach the same state";
+    ASSERT_EQ(expected.hash(), next.hash()) << "The hash is updated as it would be computed afresh";
+    ASSERT_EQ(static_cast<size_t>(WW::StateTable::hash(table.attributes(next))), next.hash());
+
+    size_t states = table.size();
+    ASSERT_EQ(next, table.apply(start, changes));
+    ASSERT_EQ(states, table.size());
+    ASSERT_EQ(start, table.apply(start, parse(names, "a, !d")));
+}
+
+TEST(TestStateTable, ApplyAlongAndAcrossPaths)
+{
+    WW::AttributeTable names;
+    WW::StateTable table;
+    const WW::AttributeTable::ids_t red = parse(names, "colour=red");
+    const WW::AttributeTable::ids_t big = parse(names, "big");
+    const WW::AttributeTable::ids_t small = parse(names, "!big, small");
+    WW::StateId start = table.intern(parse(names, "a"));
+    WW::StateId first = table.apply(start, red);
+    WW::StateId deeper = table.apply(first, big);
+    WW::StateId sibling = table.apply(first, small);
+    WW::StateId back = table.apply(start, big);
+    WW::StateId elsewhere = table.apply(table.intern(parse(names, "b")), red);
+    ASSERT_EQ(table.intern(parse(names, "a, colour=red, big")), deeper);
+    ASSERT_EQ(table.intern(parse(names, "a, colour=red, small")), sibling);
+    ASSERT_EQ(table.intern(parse(names, "a, big")), back);
+    ASSERT_EQ(table.intern(parse(names, "b, colour=red")), elsewhere);
+    ASSERT_EQ(table.intern(parse(names, "a, colour=red, small")), table.apply(deeper, small));
+
+    WW::StateId state = start;
+    for (size_t i = 0; i < 200; ++i) {
+        state = table.apply(state, (i % 2 == 0) ? big : small);
+    }
+    ASSERT_EQ(table.intern(parse(names, "a, small")), state) << "A long path is followed correctly";
+    ASSERT_EQ(first, table.apply(start, red));
+}
+
+TEST(TestStateTable, Clear)
+{
+    WW::AttributeTable names;
+    WW::StateTable table;
+    table.intern(parse(names, "a, b"));
+    ASSERT_LT(static_cast<size_t>(0), table.memoryUsed());
+    table.clear();
+    ASSERT_EQ(static_cast<size_t>(0), table.size());
+    ASSERT_EQ(static_cast<size_t>(0), table.memoryUsed());
+    WW::StateId a = table.intern(parse(names, "a"));
+    ASSERT_EQ(static_cast<size_t>(1), table.size());
+    ASSERT_EQ(parse(names, "a"), table.attributes(a));
+}
@@ -9,7 +9,14 @@
 #include "Steps.h"
 #include "TestException.h"
 
+#include <map>
+#include <random>
+#include <set>
 #include <sstream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
 
 TEST(TestStep, LoadFromStream)
 {
@@ -370,3 +377,591 @@ TEST(TestStep, TestMultipleCompoundDeps)
     ASSERT_EQ("one", it->short_desc());
     ++it;
 }
+
+TEST(TestStep, ThreadsGiveSamePlan)
+{
+    WW::Steps steps;
+    steps.setShowProgress(false);
+    for (int i = 0; i < 8; ++i) {
+        std::ostringstream ost;
+        int layer = i % 4; // each layer depends only on the one below
+        ost << "short: setup" << i << "\n"
+            << "changes: layer" << layer << ",!layer" << ((layer + 2) % 4) << "\n"
+            << "cost: " << (1 + i % 3) << "\n";
+        if (layer > 0) {
+            ost << "dependencies: layer" << (layer - 1) << "\n";
+        }
+        steps.addStep(ost.str());
+    }
+    for (int i = 0; i < 20; ++i) {
+        std::ostringstream ost;
+        ost << "short: work" << i << "\n"
+            << "dependencies: layer" << (i % 4) << "\n"
+            << "changes: !layer" << ((i * 7) % 4) << "\n"
+            << "cost: 1\n"
+            << "required: yes\n";
+        steps.addStep(ost.str());
+    }
+
+    steps.setThreads(1);
+    WW::StepList serial = steps.calculate();
+    steps.setThreads(4);
+    WW::StepList parallel = steps.calculate();
+
+    ASSERT_FALSE(serial.empty());
+    ASSERT_EQ(serial.size(), parallel.size());
+    for (WW::StepList::const_iterator it = serial.begin(), it_parallel = parallel.begin(); it != serial.end(); ++it, ++it_parallel) {
+        ASSERT_EQ(it->short_desc(), it_parallel->short_desc());
+    }
+}
+
+TEST(TestStep, PruningKeepsCheapest)
+{
+    WW::Steps steps;
+    steps.setShowProgress(false);
+    steps.addStep("short: work\ndependencies: ready\ncost: 1\nrequired: yes\n");
+    steps.addStep("short: slow\ndependencies: a\nchanges: ready\ncost: 5\n");
+    steps.addStep("short: a\nchanges: a\ncost: 1\n");
+    steps.addStep("short: fast\ndependencies: b\nchanges: ready\ncost: 2\n");
+    steps.addStep("short: b\nchanges: b\ncost: 1\n");
+    steps.addStep("short: dear\ndependencies: c\nchanges: ready\ncost: 2\n");
+    steps.addStep("short: c\nchanges: c\ncost: 2\n");
+
+    WW::StepList solution = steps.calculate();
+    ASSERT_EQ(static_cast<size_t>(3), solution.size());
+    WW::StepList::const_iterator it = solution.begin();
+    ASSERT_EQ("b", it->short_desc());
+    ++it;
+    ASSERT_EQ("fast", it->short_desc()) << "Cheaper than 'slow' and 'dear' once their dependencies are counted";
+    ++it;
+    ASSERT_EQ("work", it->short_desc());
+}
+
+TEST(TestStep, StateSearchAvoidsUndoingTarget)
+{
+    WW::Steps steps;
+    steps.setShowProgress(false);
+    steps.setState(WW::Steps::attributes_t("z"));
+    steps.addStep("short: work\ndependencies: x,z\ncost: 1\nrequired: yes\n");
+    steps.addStep("short: cheap\nchanges: x,!z\ncost: 1\n");
+    steps.addStep("short: careful\nchanges: x\ncost: 3\n");
+    steps.addStep("short: restore\nchanges: z\ncost: 10\n");
+
+    WW::StepList solution = steps.calculate();
+    ASSERT_EQ(static_cast<size_t>(3), solution.size()) << "The recursive engine takes the cheapest step providing x, then has to restore z";
+    ASSERT_EQ("cheap", solution.begin()->short_desc());
+
+    steps.setEngine(WW::Steps::ASTAR);
+    solution = steps.calculate();
+    ASSERT_EQ(static_cast<size_t>(2), solution.size());
+    WW::StepList::const_iterator it = solution.begin();
+    ASSERT_EQ("careful", it->short_desc()) << "Searching the states finds the cheapest way to x and z together";
+    ++it;
+    ASSERT_EQ("work", it->short_desc());
+}
+
+namespace {
+    /** Steps `s0` to `s<length-1>`, each depending on the one before, and a
+     * required step depending on the last of them.
+     */
+    void
+        addChain(WW::Steps& steps, int length)
+        {
+            for (int i = 0; i < length; ++i) {
+                std::ostringstream ost;
+                ost << "short: s" << i << "\n"
+                    << "changes: a" << i << "\n"
+                    << "cost: 1\n";
+                if (i > 0) {
+                    ost << "dependencies: a" << (i - 1) << "\n";
+                }
+                steps.addStep(ost.str());
+            }
+            std::ostringstream ost;
+            ost << "short: work\ndependencies: a" << (length - 1) << "\ncost: 1\nrequired: yes\n";
+            steps.addStep(ost.str());
+        }
+
+    void*
+        calculateSize(void* steps)
+        {
+            return reinterpret_cast<void*>(static_cast<WW::Steps*>(steps)->calculate().size());
+        }
+}
+
+TEST(TestStep, DeepChainOnSmallStack)
+{
+    WW::Steps steps;
+    steps.setShowProgress(false);
+    addChain(steps, 1000);
+
+    // Every step of the chain is a nested solve, far more than would fit
+    // on this stack were each a level of recursion.
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 256 * 1024);
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, &attr, calculateSize, &steps));
+    pthread_attr_destroy(&attr);
+    void* size = 0;
+    pthread_join(thread, &size);
+    ASSERT_EQ(static_cast<size_t>(1001), reinterpret_cast<size_t>(size));
+}
+
+TEST(TestStep, DepthLimit)
+{
+    WW::Steps steps;
+    steps.setShowProgress(false);
+    addChain(steps, 50);
+
+    steps.setDepthLimit(10);
+    ASSERT_THROW(steps.calculate(), WW::TestException) << "The chain is too long to solve within the limit";
+    steps.setDepthLimit(51);
+    ASSERT_EQ(static_cast<size_t>(51), steps.calculate().size());
+}
+
+TEST(TestStep, CyclesAreCut)
+{
+    WW::Steps steps;
+    steps.setShowProgress(false);
+    // 'p' and 'q' each provide what the other needs, and cost nothing, so
+    // no bound stops a solve of one going round through the other
+    steps.addStep("short: p\ndependencies: y\nchanges: x\ncost: 0\n");
+    steps.addStep("short: q\ndependencies: x\nchanges: y\ncost: 0\n");
+    steps.addStep("short: r\nchanges: x\ncost: 3\n");
+    steps.addStep("short: work\ndependencies: x,y\ncost: 1\nrequired: yes\n");
+
+    WW::StepList solution = steps.calculate();
+    ASSERT_EQ(static_cast<size_t>(3), solution.size()) << "Going round the cycle achieves nothing";
+    WW::StepList::const_iterator it = solution.begin();
+    ASSERT_EQ("r", it->short_desc()) << "Only 'r' breaks into the cycle";
+    ++it;
+    ASSERT_EQ("q", it->short_desc());
+    ++it;
+    ASSERT_EQ("work", it->short_desc());
+    ASSERT_LT(static_cast<unsigned long>(0), steps.stats().cyclesCut) << "The solve of 'x' went round through 'p' and 'q'";
+}
+
+TEST(TestStep, UnreachableStepsAreSkipped)
+{
+    WW::Steps steps;
+    steps.setShowProgress(false);
+    steps.addStep("short: setup\nchanges: ready\ncost: 1\n");
+    steps.addStep("short: blocked\ndependencies: key\nchanges: open\ncost: 1\n");
+    steps.addStep("short: work\ndependencies: ready\ncost: 1\nrequired: yes\n");
+    steps.addStep("short: locked\ndependencies: ready,open\ncost: 1\nrequired: yes\n");
+
+    WW::StepList solution = steps.calculate();
+    ASSERT_EQ(static_cast<size_t>(2), solution.size()) << "Nothing provides 'key', so 'locked' can never run";
+    WW::StepList::const_iterator it = solution.begin();
+    ASSERT_EQ("setup", it->short_desc());
+    ++it;
+    ASSERT_EQ("work", it->short_desc());
+}
+
+TEST(TestStep, DominatedStepsAreNotChosen)
+{
+    const WW::Steps::Engine engines[] = { WW::Steps::RECURSIVE, WW::Steps::ASTAR };
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); ++i) {
+        WW::Steps steps;
+        steps.setShowProgress(false);
+        steps.setEngine(engines[i]);
+        steps.addStep("short: slowSetup\ndependencies: power\nchanges: ready\ncost: 3\n");
+        steps.addStep("short: dearSetup\nchanges: ready\ncost: 2\n");
+        steps.addStep("short: powerOn\nchanges: power\ncost: 1\n");
+        steps.addStep("short: setup\nchanges: ready\ncost: 1\n");
+        steps.addStep("short: work\ndependencies: ready\ncost: 1\nrequired: yes\n");
+
+        WW::StepList solution = steps.calculate();
+        ASSERT_EQ(static_cast<size_t>(2), solution.size());
+        WW::StepList::const_iterator it = solution.begin();
+        ASSERT_EQ("setup", it->short_desc()) << "engine " << engines[i];
+        ++it;
+        ASSERT_EQ("work", it->short_desc());
+    }
+}
+
+namespace {
+    /** Every use needs `a` and `b` built.  Setting `a` first is as cheap a
+     * start as any, but then `b` needs it cleared again.
+     */
+    void
+        addBuild(WW::Steps& steps, unsigned int setBCost)
+        {
+            std::ostringstream setB;
+            setB << "short: setB\ndependencies: !a\nchanges: b\ncost: " << setBCost << "\n";
+            steps.setShowProgress(false);
+            steps.addStep("short: setA\nchanges: a\ncost: 1\n");
+            steps.addStep(setB.str());
+            steps.addStep("short: clearA\nchanges: !a\ncost: 10\n");
+            steps.addStep("short: build\ndependencies: a,b\nchanges: built\ncost: 1\n");
+            for (int i = 0; i < 4; ++i) {
+                std::ostringstream use;
+                use << "short: use" << i << "\ndependencies: built\nchanges: used" << i << ",!a,!b,!built\ncost: 1\nrequired: yes\n";
+                steps.addStep(use.str());
+            }
+        }
+
+    /** Four required steps, which cost 23 when each is inserted in turn at
+     * its best point, but 18 in the best order.
+     *
+     * Until `fill` itself is placed, `mix` gets the `a` it needs by running
+     * fill, which the recursive engine, guided by the steps to come, takes
+     * over the cheaper setA.  So wherever the required fill is then put, it
+     * runs twice: fill, setD, drain, fill, mix, use costs 5+1+5+5+4+3 = 23.
+     * Run straight after fill, mix needs nothing more, and drain only
+     * undoes `a` after that: fill, mix, setD, drain, use costs
+     * 5+4+1+5+3 = 18.
+     */
+    void
+        addRefill(WW::Steps& steps)
+        {
+            steps.addStep("short: setA\nchanges: a\ncost: 2\n");
+            steps.addStep("short: mix\ndependencies: !b,a\nchanges: c,!a\ncost: 4\nrequired: yes\n");
+            steps.addStep("short: setD\nchanges: d\ncost: 1\n");
+            steps.addStep("short: drain\ndependencies: d\nchanges: !a\ncost: 5\nrequired: yes\n");
+            steps.addStep("short: use\ndependencies: c,!a\ncost: 3\nrequired: yes\n");
+            steps.addStep("short: fill\ndependencies: !b\nchanges: a\ncost: 5\nrequired: yes\n");
+        }
+
+    /** Two required steps, where `early` can never run: it needs `b`
+     * without `a`, and setAB sets both.  The plan leaves it out, but an
+     * order holding it can not be walked step by step.
+     */
+    void
+        addUnwalkable(WW::Steps& steps)
+        {
+            steps.addStep("short: setAB\nchanges: a,b\ncost: 1\n");
+            steps.addStep("short: setC\ndependencies: !d\nchanges: c,d\ncost: 3\n");
+            steps.addStep("short: late\ndependencies: a\nchanges: !b\ncost: 1\nrequired: yes\n");
+            steps.addStep("short: early\ndependencies: !a,b,c\nchanges: e\ncost: 5\nrequired: yes\n");
+        }
+
+    /** Three required steps which run only as setB, needAClear, setAB,
+     * since needAClear can not follow setAB, and nothing clears `a`.
+     * Insertion places them otherwise, so can not walk its order.
+     */
+    void
+        addOneWayOnly(WW::Steps& steps)
+        {
+            steps.addStep("short: needAClear\ndependencies: !a,b,!c\nchanges: d,e\ncost: 2\nrequired: yes\n");
+            steps.addStep("short: setAB\nchanges: a,b\ncost: 2\nrequired: yes\n");
+            steps.addStep("short: setB\ndependencies: !c\nchanges: b\ncost: 4\nrequired: yes\n");
+        }
+
+    /** A catalog generated from `seed`: steps setting and clearing each of
+     * eight attributes, steps setting `k` which need `a0`, and fourteen
+     * more, the first six of them required.  Each of those needs a few of
+     * the attributes below some point, and changes a few of those above it.
+     */
+    void
+        addGenerated(WW::Steps& steps, unsigned int seed)
+        {
+            std::mt19937 random(seed);
+            const unsigned int attributes = 8;
+            const char* const values[] = { "x", "y", "z" };
+            for (unsigned int i = 0; i < attributes; ++i) {
+                std::ostringstream set;
+                set << "short: setA" << i << "\nchanges: a" << i << "\ncost: " << 1 + random() % 4 << "\n";
+                steps.addStep(set.str());
+                std::ostringstream clear;
+                clear << "short: clearA" << i << "\nchanges: !a" << i << "\ncost: " << 1 + random() % 4 << "\n";
+                steps.addStep(clear.str());
+            }
+            for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+                std::ostringstream set;
+                set << "short: setK" << values[i] << "\ndependencies: a0\nchanges: k=" << values[i] << "\ncost: " << 1 + random() % 3 << "\n";
+                steps.addStep(set.str());
+            }
+            for (unsigned int i = 0; i < 14; ++i) {
+                const bool required = (i < 6);
+                const unsigned int split = 1 + random() % (attributes - 1); // needs attributes below, changes those from here on
+                std::ostringstream step;
+                step << "short: s" << i << "\ndependencies: ";
+                const char* separator = "";
+                for (unsigned int n = random() % 4, a = 0; a < split && n > 0; ++a) {
+                    if (random() % (split - a) < n) {
+                        step << separator << (random() % 10 < 3 ? "!" : "") << "a" << a;
+                        separator = ",";
+                        --n;
+                    }
+                }
+                if (random() % 10 < 3) {
+                    step << separator << "k=" << values[random() % 3];
+                }
+                step << "\nchanges: ";
+                separator = "";
+                for (unsigned int n = (required ? 0 : 1) + random() % (required ? 3 : 2), a = split; a < attributes && n > 0; ++a) {
+                    if (random() % (attributes - a) < n) {
+                        step << separator << (random() % 10 < 4 ? "!" : "") << "a" << a;
+                        separator = ",";
+                        --n;
+                    }
+                }
+                step << "\ncost: " << 1 + random() % 5 << "\nrequired: " << (required ? "yes" : "no") << "\n";
+                steps.addStep(step.str());
+            }
+        }
+
+    unsigned int
+        totalCost(const WW::StepList& steps)
+        {
+            unsigned int result = 0;
+            for (WW::StepList::const_iterator it = steps.begin(); it != steps.end(); ++it) {
+                result += it->cost();
+            }
+            return result;
+        }
+
+    size_t
+        macroMembers(const std::string& saved)
+        {
+            size_t result = 0;
+            std::istringstream ist(saved);
+            std::string line;
+            while (std::getline(ist, line)) {
+                if (!line.empty() && line[0] != '#') {
+                    ++result;
+                }
+            }
+            return result;
+        }
+}
+
+TEST(TestStep, MacroStepsAreLearnedAndReused)
+{
+    WW::Steps learning;
+    addBuild(learning, 1);
+    learning.setEngine(WW::Steps::ASTAR);
+    learning.setLearnMacros(true);
+    unsigned int cheapest = totalCost(learning.calculate());
+    std::ostringstream saved;
+    learning.saveMacros(saved);
+    ASSERT_EQ(static_cast<size_t>(3), macroMembers(saved.str())) << "setB, setA and build recur before every use";
+
+    WW::Steps plain;
+    addBuild(plain, 1);
+    WW::StepList expected = plain.calculate();
+    ASSERT_LT(cheapest, totalCost(expected));
+
+    WW::Steps reusing;
+    addBuild(reusing, 1);
+    std::istringstream macros(saved.str());
+    reusing.loadMacros(macros);
+    WW::StepList solution = reusing.calculate();
+    ASSERT_EQ(expected.size(), solution.size()) << "the chain guides the choice of every step in the plan, not the macro steps";
+    for (WW::StepList::const_iterator it = expected.begin(), other = solution.begin(); it != expected.end(); ++it, ++other) {
+        ASSERT_EQ(it->short_desc(), other->short_desc());
+    }
+    std::ostringstream resaved;
+    reusing.saveMacros(resaved);
+    ASSERT_EQ(saved.str(), resaved.str());
+
+    WW::Steps changed;
+    addBuild(changed, 2);
+    std::istringstream stale(saved.str());
+    changed.loadMacros(stale);
+    changed.calculate();
+    std::ostringstream dropped;
+    changed.saveMacros(dropped);
+    ASSERT_EQ(static_cast<size_t>(0), macroMembers(dropped.str())) << "a member has changed";
+}
+
+TEST(TestStep, HubPlansAreSavedAndReused)
+{
+    const WW::Steps::Engine engines[] = { WW::Steps::RECURSIVE, WW::Steps::ASTAR };
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); ++i) {
+        WW::Steps plain;
+        addBuild(plain, 1);
+        plain.setEngine(engines[i]);
+        unsigned int expected = totalCost(plain.calculate());
+
+        WW::Steps first;
+        addBuild(first, 1);
+        first.setEngine(engines[i]);
+        first.setHubs(2);
+        ASSERT_GE(expected, totalCost(first.calculate())) << "a hub plan only ever bounds a solve; engine " << engines[i];
+        std::ostringstream saved;
+        first.saveHubs(saved);
+        ASSERT_NE(std::string::npos, saved.str().find("target: built")) << "every use needs 'built'";
+
+        WW::Steps reusing;
+        addBuild(reusing, 1);
+        reusing.setEngine(engines[i]);
+        reusing.setHubs(2);
+        std::istringstream hubs(saved.str());
+        reusing.loadHubs(hubs);
+        ASSERT_GE(expected, totalCost(reusing.calculate()));
+        std::ostringstream resaved;
+        reusing.saveHubs(resaved);
+        ASSERT_EQ(saved.str(), resaved.str());
+
+        WW::Steps changed;
+        addBuild(changed, 2);
+        changed.setEngine(engines[i]);
+        changed.setHubs(2);
+        std::istringstream stale(saved.str());
+        changed.loadHubs(stale);
+        changed.calculate();
+        std::ostringstream recomputed;
+        changed.saveHubs(recomputed);
+        ASSERT_NE(saved.str(), recomputed.str()) << "a step has changed, so the plans are worked out again";
+    }
+}
+
+TEST(TestStep, BeamSearchBeatsInsertionOnAGeneratedCatalog)
+{
+    const unsigned int widths[] = { 1, 4 };
+    unsigned int costs[2] = { 0, 0 };
+    for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); ++i) {
+        WW::Steps steps;
+        steps.setShowProgress(false);
+        steps.setBeamWidth(widths[i]);
+        addGenerated(steps, 248);
+        costs[i] = totalCost(steps.calculate());
+    }
+    ASSERT_EQ(static_cast<unsigned int>(54), costs[0]);
+    ASSERT_EQ(static_cast<unsigned int>(35), costs[1]) << "the beam ranks its orders by the cost of the plan taken for them";
+}
+
+namespace {
+    /** The generated catalog the beam search test orders */
+    void
+        addGenerated248(WW::Steps& steps)
+        {
+            addGenerated(steps, 248);
+        }
+
+    /** One way of ordering the required steps of a catalog, and what it
+     * should come to
+     */
+    struct OrderingCase
+    {
+        const char* name;
+        void (*catalog)(WW::Steps& steps);
+        unsigned int threads;
+        unsigned int beamWidth;
+        unsigned int exactLimit;
+        unsigned int searchTime; // milliseconds of local search
+        unsigned int portfolioTime; // milliseconds; zero for no portfolio
+        unsigned int cost; // of the plan
+        const char* samePlanAs; // an earlier case whose plan this matches, if any
+    };
+
+    const OrderingCase ORDERING_CASES[] = {
+        { "insertion", addRefill, 1, 1, 0, 0, 0, 23, 0 },
+        { "beam search", addRefill, 1, 4, 0, 0, 0, 18, 0 },
+        { "local search", addRefill, 1, 1, 0, 60000, 0, 18, 0 },
+        { "local search again", addRefill, 1, 1, 0, 60000, 0, 18, "local search" }, // the same seed makes the same moves
+        { "local search of an order which can not be walked", addUnwalkable, 1, 1, 0, 60000, 0, 2, 0 },
+        { "exact ordering above its limit", addRefill, 1, 1, 3, 0, 0, 23, 0 },
+        { "exact ordering", addRefill, 1, 1, 4, 0, 0, 18, 0 },
+        { "exact ordering on four threads", addRefill, 4, 1, 4, 0, 0, 18, "exact ordering" },
+        { "exact ordering of a generated catalog", addGenerated248, 1, 1, 6, 0, 0, 35, 0 },
+        { "exact ordering of a generated catalog on four threads", addGenerated248, 4, 1, 6, 0, 0, 35, "exact ordering of a generated catalog" }, // subsets run beneath each other's solves
+        { "portfolio", addRefill, 1, 1, 0, 0, 60000, 18, 0 },
+        { "portfolio on four threads", addRefill, 4, 1, 0, 0, 60000, 18, "portfolio" }, // whichever strategy finishes first
+    };
+}
+
+TEST(TestStep, OrderingStrategies)
+{
+    const size_t count = sizeof(ORDERING_CASES) / sizeof(ORDERING_CASES[0]);
+    std::map<std::string, std::string> plans; // by the name of the case
+    for (size_t i = 0; i < count; ++i) {
+        const OrderingCase& ordering = ORDERING_CASES[i];
+        WW::Steps steps;
+        steps.setShowProgress(false);
+        steps.setThreads(ordering.threads);
+        steps.setBeamWidth(ordering.beamWidth);
+        steps.setExactLimit(ordering.exactLimit);
+        steps.setLocalSearch(ordering.searchTime, 3);
+        steps.setPortfolio(ordering.portfolioTime);
+        ordering.catalog(steps);
+        WW::StepList plan = steps.calculate();
+        std::string& described = plans[ordering.name];
+        for (WW::StepList::const_iterator it = plan.begin(); it != plan.end(); ++it) {
+            described += it->short_desc() + " ";
+        }
+        ASSERT_EQ(ordering.cost, totalCost(plan)) << ordering.name << ": " << described;
+        if (ordering.samePlanAs != 0) {
+            ASSERT_EQ(plans[ordering.samePlanAs], described) << ordering.name;
+        }
+    }
+}
+
+TEST(TestStep, PortfolioOutlivesAStrategyWhichThrows)
+{
+    WW::Steps alone;
+    alone.setShowProgress(false);
+    addOneWayOnly(alone);
+    ASSERT_THROW(alone.calculate(), WW::TestException) << "insertion can not walk its order";
+
+    WW::Steps steps;
+    steps.setShowProgress(false);
+    steps.setPortfolio(60000);
+    addOneWayOnly(steps);
+    ASSERT_EQ(static_cast<unsigned int>(8), totalCost(steps.calculate())) << "the portfolio takes exact ordering's plan";
+}
+
+TEST(TestStep, PortfolioStopsAtItsDeadline)
+{
+    const size_t uses = 40;
+    WW::Steps steps;
+    steps.setShowProgress(false);
+    steps.setPortfolio(1);
+    steps.addStep("short: set\nchanges: a\ncost: 1\n");
+    steps.addStep("short: clear\nchanges: !a\ncost: 1\n");
+    for (size_t i = 0; i < uses; ++i) {
+        std::ostringstream step;
+        step << "short: use" << i << "\ndependencies: " << ((i % 2 == 0) ? "a" : "!a") << "\ncost: 1\nrequired: yes\n";
+        steps.addStep(step.str());
+    }
+    WW::StepList plan = steps.calculate();
+    std::set<std::string> used;
+    for (WW::StepList::const_iterator it = plan.begin(); it != plan.end(); ++it) {
+        if (it->short_desc().compare(0, 3, "use") == 0) {
+            used.insert(it->short_desc());
+        }
+    }
+    ASSERT_LT(static_cast<size_t>(0), steps.stats().strategiesCutShort) << "the beam can not order 40 steps in a millisecond";
+    ASSERT_EQ(uses, used.size()) << "the plan taken at the deadline still runs every required step";
+}
+
+namespace {
+    void
+        addModule(WW::Steps& steps, const std::string& name)
+        {
+            steps.addStep("short: " + name + "Install\nchanges: " + name + "\ncost: 5\n");
+            steps.addStep("short: " + name + "Start\ndependencies: " + name + "\nchanges: " + name + "Running\ncost: 1\n");
+            steps.addStep("short: " + name + "Stop\ndependencies: " + name + "Running\nchanges: !" + name + "Running\ncost: 1\n");
+            steps.addStep("short: " + name + "Upgrade\ndependencies: " + name + ",!" + name + "Running\ncost: 2\nrequired: yes\n");
+            steps.addStep("short: " + name + "Use\ndependencies: " + name + "Running\ncost: 1\nrequired: yes\n");
+        }
+}
+
+TEST(TestStep, ComponentsAreSequencedSeparately)
+{
+    const char* modules[] = { "lights", "heating", "doors" };
+    WW::Steps all;
+    all.setShowProgress(false);
+    all.setThreads(3);
+    std::vector<std::string> expected;
+    for (size_t i = 0; i < sizeof(modules) / sizeof(modules[0]); ++i) {
+        addModule(all, modules[i]);
+        WW::Steps alone;
+        alone.setShowProgress(false);
+        addModule(alone, modules[i]);
+        WW::StepList plan = alone.calculate();
+        for (WW::StepList::const_iterator it = plan.begin(); it != plan.end(); ++it) {
+            expected.push_back(it->short_desc());
+        }
+    }
+
+    WW::StepList solution = all.calculate();
+    ASSERT_EQ(expected.size(), solution.size());
+    std::vector<std::string>::const_iterator it_expected = expected.begin();
+    for (WW::StepList::const_iterator it = solution.begin(); it != solution.end(); ++it, ++it_expected) {
+        ASSERT_EQ(*it_expected, it->short_desc()) << "Each module is sequenced as if it were alone, in the order they were added";
+    }
+}
@@ -27,3 +27,33 @@ TEST(TestStepList, TestList)
     ASSERT_EQ(list.begin(), it);
 }
 
+
+TEST(TestStepList, RandomAccessAndSplice)
+{
+    WW::TestStep steps[4];
+    const char* names[] = { "one", "two", "three", "four" };
+    WW::StepList first;
+    WW::StepList second;
+    for (size_t i = 0; i < 4; ++i) {
+        steps[i].short_desc(names[i]);
+        (i < 2 ? first : second).push_back(steps[i]);
+    }
+
+    first.splice(first.end(), second);
+    ASSERT_EQ(static_cast<size_t>(4), first.size());
+    ASSERT_TRUE(second.empty());
+    ASSERT_EQ("three", first[2].short_desc());
+    ASSERT_EQ("four", (first.begin() + 3)->short_desc());
+    ASSERT_EQ(4, first.end() - first.begin());
+
+    WW::StepList slice(first.begin() + 1, first.begin() + 3);
+    ASSERT_EQ(static_cast<size_t>(2), slice.size());
+    ASSERT_EQ("two", slice.front().short_desc());
+    ASSERT_EQ("three", slice.back().short_desc());
+
+    WW::StepList::iterator it = first.erase(first.begin() + 1);
+    ASSERT_EQ("three", it->short_desc());
+    second.splice(second.end(), first);
+    ASSERT_EQ(static_cast<size_t>(3), second.size());
+    ASSERT_TRUE(first.empty());
+}
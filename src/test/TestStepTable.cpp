@@ -0,0 +1,139 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include <gtest/gtest.h>
+
+#include "StepTable.h"
+
+#include <sstream>
+
+typedef WW::AttributeTable::attributes_t attributes_t;
+typedef WW::AttributeTable::ids_t ids_t;
+
+namespace {
+    WW::AttributeTable::id_operation_t
+        makeOperation(WW::AttributeTable& table, const char* dependencies, const char* changes)
+        {
+            WW::AttributeTable::operation_t operation;
+            if (dependencies[0] != '\0') {
+                operation.dependencies(attributes_t(dependencies));
+            }
+            if (changes[0] != '\0') {
+                operation.changes(attributes_t(changes));
+            }
+            return table.intern(operation);
+        }
+}
+
+TEST(TestStepTable, MatchesOperation)
+{
+    const char* operations[][2] = {
+        { "", "one" },
+        { "one", "!one,two" },
+        { "!two", "fruit=apple" },
+        { "fruit=apple", "fruit=pear,!one" },
+        { "fruit=pear,!one", "!fruit" },
+        { "!fruit=pear,two", "three" },
+        { "one,two,three", "!three" },
+    };
+    const char* states[] = {
+        "zero", "one", "two", "one,two", "fruit=apple", "fruit=pear", "!one,fruit=pear", "!fruit=pear,two",
+        "one,two,three", "!two,one",
+    };
+
+    WW::AttributeTable table;
+    std::vector<WW::AttributeTable::id_operation_t> ops;
+    for (size_t i = 0; i < sizeof(operations) / sizeof(operations[0]); ++i) {
+        ops.push_back(makeOperation(table, operations[i][0], operations[i][1]));
+    }
+    WW::StepTable steps(ops);
+    ASSERT_EQ(ops.size(), steps.size());
+
+    for (size_t s = 0; s < sizeof(states) / sizeof(states[0]); ++s) {
+        ids_t state = table.intern(attributes_t(states[s]));
+        WW::StepTable::mask_t present;
+        steps.stateMask(state, present);
+
+        WW::StepTable::indices_t valid;
+        WW::StepTable::indices_t expectedValid;
+        steps.findValid(present, valid);
+
+        WW::StepTable::indices_t providing;
+        WW::StepTable::indices_t expectedProviding;
+        steps.findProviding(state, providing);
+
+        for (size_t op = 0; op < ops.size(); ++op) {
+            ASSERT_EQ(ops[op].isValid(state), steps.isValid(op, present)) << "operation " << op << " in " << states[s];
+            if (ops[op].isValid(state)) {
+                expectedValid.push_back(op);
+            }
+            if (ops[op].changes().containsAny(state)) {
+                expectedProviding.push_back(op);
+            }
+        }
+        ASSERT_EQ(expectedValid, valid) << states[s];
+        ASSERT_EQ(expectedProviding, providing) << states[s];
+    }
+}
+
+TEST(TestStepTable, ManyAttributes)
+{
+    WW::AttributeTable table;
+    std::vector<WW::AttributeTable::id_operation_t> ops;
+    for (int i = 0; i < 200; ++i) {
+        std::ostringstream dependencies;
+        std::ostringstream changes;
+        dependencies << "a" << i;
+        changes << "a" << (i + 1) << ",!a" << i;
+        ops.push_back(makeOperation(table, dependencies.str().c_str(), changes.str().c_str()));
+    }
+    WW::StepTable steps(ops);
+    ASSERT_GT(steps.words(), static_cast<size_t>(1)) << "Attributes span more than a single word";
+
+    WW::StepTable::mask_t present;
+    steps.stateMask(table.intern(attributes_t("a150")), present);
+    WW::StepTable::indices_t valid;
+    steps.findValid(present, valid);
+    ASSERT_EQ(static_cast<size_t>(1), valid.size());
+    ASSERT_EQ(static_cast<size_t>(150), valid[0]);
+
+    WW::StepTable::indices_t providing;
+    steps.findProviding(table.intern(attributes_t("a150")), providing);
+    ASSERT_EQ(static_cast<size_t>(1), providing.size());
+    ASSERT_EQ(static_cast<size_t>(149), providing[0]);
+}
+
+TEST(TestStepTable, ProvidersOfCompoundValues)
+{
+    WW::AttributeTable table;
+    std::vector<WW::AttributeTable::id_operation_t> ops;
+    ops.push_back(makeOperation(table, "", "fruit=apple"));
+    ops.push_back(makeOperation(table, "", "fruit=pear"));
+    ops.push_back(makeOperation(table, "", "!fruit=apple"));
+    ops.push_back(makeOperation(table, "", "fruit"));
+    ops.push_back(makeOperation(table, "", "fruit=apple,one"));
+    WW::StepTable steps(ops);
+
+    WW::StepTable::indices_t providing;
+    steps.findProviding(table.intern(attributes_t("fruit=apple")), providing);
+    ASSERT_EQ(static_cast<size_t>(2), providing.size()) << "Other values of the same key do not provide the value";
+    ASSERT_EQ(static_cast<size_t>(0), providing[0]);
+    ASSERT_EQ(static_cast<size_t>(4), providing[1]);
+
+    steps.findProviding(table.intern(attributes_t("!fruit=apple")), providing);
+    ASSERT_EQ(static_cast<size_t>(1), providing.size());
+    ASSERT_EQ(static_cast<size_t>(2), providing[0]);
+
+    steps.findProviding(table.intern(attributes_t("one,!fruit=apple")), providing);
+    ASSERT_EQ(static_cast<size_t>(1), providing.size()) << "A step which provides one change but contradicts another is not a provider";
+    ASSERT_EQ(static_cast<size_t>(2), providing[0]);
+
+    WW::StepTable::mask_t adds;
+    WW::StepTable::mask_t removes;
+    WW::StepTable::indices_t scanned;
+    steps.changeMasks(table.intern(attributes_t("one,!fruit=apple")), adds, removes);
+    steps.findProviding(adds, removes, scanned);
+    ASSERT_EQ(providing, scanned) << "The index agrees with a scan of the masks";
+}
@@ -0,0 +1,95 @@
+// Copyright 2015 Sophos Limited. All rights reserved.
+//
+// Sophos is a registered trademark of Sophos Limited and Sophos Group.
+//
+
+#include <gtest/gtest.h>
+
+#include "ThreadPool.h"
+
+#include <stdexcept>
+#include <vector>
+
+TEST(TestThreadPool, RunsEveryIndexOnce)
+{
+    WW::ThreadPool pool(4);
+    ASSERT_EQ(4u, pool.size());
+
+    for (int round = 0; round < 3; ++round) {
+        std::vector<int> counts(1000);
+        std::vector<unsigned int> workers(counts.size());
+        pool.run(counts.size(), [&](size_t index, unsigned int worker) {
+            ++counts[index];
+            workers[index] = worker;
+        });
+        for (size_t index = 0; index < counts.size(); ++index) {
+            ASSERT_EQ(1, counts[index]) << "index " << index << " in round " << round;
+            ASSERT_LT(workers[index], pool.size());
+        }
+    }
+}
+
+TEST(TestThreadPool, SingleWorkerUsesCallingThread)
+{
+    WW::ThreadPool pool(1);
+    ASSERT_EQ(1u, pool.size());
+
+    std::vector<size_t> order;
+    pool.run(5, [&](size_t index, unsigned int worker) {
+        ASSERT_EQ(0u, worker);
+        order.push_back(index);
+    });
+    ASSERT_EQ(5u, order.size());
+    for (size_t index = 0; index < order.size(); ++index) {
+        ASSERT_EQ(index, order[index]) << "Tasks run in order on a single thread";
+    }
+}
+
+TEST(TestThreadPool, RethrowsTaskException)
+{
+    WW::ThreadPool pool(3);
+    std::vector<int> counts(100);
+    ASSERT_THROW(pool.run(counts.size(), [&](size_t index, unsigned int) {
+        ++counts[index];
+        if (index == 42) {
+            throw std::runtime_error("task failed");
+        }
+    }), std::runtime_error);
+    for (size_t index = 0; index < counts.size(); ++index) {
+        ASSERT_EQ(1, counts[index]) << "The remaining tasks still run";
+    }
+
+    pool.run(counts.size(), [&](size_t index, unsigned int) { ++counts[index]; });
+    ASSERT_EQ(2, counts[99]) << "The pool is usable after an exception";
+}
+
+namespace {
+    long
+        parallelSum(WW::ThreadPool& pool, long first, long last)
+        {
+            if (last - first < 16) {
+                long result = 0;
+                for (long value = first; value < last; ++value) {
+                    result += value;
+                }
+                return result;
+            }
+            long middle = first + (last - first) / 2;
+            long left = 0;
+            long right = 0;
+            WW::ThreadPool::TaskGroup group(pool);
+            group.fork([&](unsigned int) { left = parallelSum(pool, first, middle); });
+            group.fork([&](unsigned int) { right = parallelSum(pool, middle, last); });
+            group.wait();
+            return left + right;
+        }
+}
+
+TEST(TestThreadPool, NestedTaskGroups)
+{
+    WW::ThreadPool pool(4);
+    ASSERT_EQ(4999950000L, parallelSum(pool, 0, 100000)) << "Tasks which wait for their own tasks do not deadlock";
+
+    WW::ThreadPool single(1);
+    ASSERT_EQ(4999950000L, parallelSum(single, 0, 100000));
+}